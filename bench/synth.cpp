@@ -0,0 +1,447 @@
+#include "synth.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <map>
+#include <set>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+namespace vgen
+{
+	namespace
+	{
+		// the commands the generated loader calls itself, with their real prototypes
+		constexpr auto bootstrap_commands = R"xml(        <command>
+            <proto><type>VkResult</type> <name>vkCreateInstance</name></proto>
+            <param>const <type>VkInstanceCreateInfo</type>* <name>pCreateInfo</name></param>
+            <param optional="true">const <type>VkAllocationCallbacks</type>* <name>pAllocator</name></param>
+            <param><type>VkInstance</type>* <name>pInstance</name></param>
+        </command>
+        <command>
+            <proto><type>void</type> <name>vkDestroyInstance</name></proto>
+            <param optional="true"><type>VkInstance</type> <name>instance</name></param>
+            <param optional="true">const <type>VkAllocationCallbacks</type>* <name>pAllocator</name></param>
+        </command>
+        <command>
+            <proto><type>VkResult</type> <name>vkEnumeratePhysicalDevices</name></proto>
+            <param><type>VkInstance</type> <name>instance</name></param>
+            <param><type>uint32_t</type>* <name>pPhysicalDeviceCount</name></param>
+            <param optional="true"><type>VkPhysicalDevice</type>* <name>pPhysicalDevices</name></param>
+        </command>
+        <command>
+            <proto><type>PFN_vkVoidFunction</type> <name>vkGetInstanceProcAddr</name></proto>
+            <param optional="true"><type>VkInstance</type> <name>instance</name></param>
+            <param>const <type>char</type>* <name>pName</name></param>
+        </command>
+        <command>
+            <proto><type>PFN_vkVoidFunction</type> <name>vkGetDeviceProcAddr</name></proto>
+            <param><type>VkDevice</type> <name>device</name></param>
+            <param>const <type>char</type>* <name>pName</name></param>
+        </command>
+        <command>
+            <proto><type>VkResult</type> <name>vkCreateDevice</name></proto>
+            <param><type>VkPhysicalDevice</type> <name>physicalDevice</name></param>
+            <param>const <type>VkDeviceCreateInfo</type>* <name>pCreateInfo</name></param>
+            <param optional="true">const <type>VkAllocationCallbacks</type>* <name>pAllocator</name></param>
+            <param><type>VkDevice</type>* <name>pDevice</name></param>
+        </command>
+        <command>
+            <proto><type>void</type> <name>vkDestroyDevice</name></proto>
+            <param optional="true"><type>VkDevice</type> <name>device</name></param>
+            <param optional="true">const <type>VkAllocationCallbacks</type>* <name>pAllocator</name></param>
+        </command>
+        <command>
+            <proto><type>VkResult</type> <name>vkEnumerateInstanceExtensionProperties</name></proto>
+            <param optional="true">const <type>char</type>* <name>pLayerName</name></param>
+            <param><type>uint32_t</type>* <name>pPropertyCount</name></param>
+            <param optional="true"><type>VkExtensionProperties</type>* <name>pProperties</name></param>
+        </command>
+        <command>
+            <proto><type>VkResult</type> <name>vkEnumerateInstanceLayerProperties</name></proto>
+            <param><type>uint32_t</type>* <name>pPropertyCount</name></param>
+            <param optional="true"><type>VkLayerProperties</type>* <name>pProperties</name></param>
+        </command>
+)xml"sv;
+
+		constexpr auto bootstrap_names = std::array{
+			"vkCreateInstance"sv,
+			"vkDestroyInstance"sv,
+			"vkEnumeratePhysicalDevices"sv,
+			"vkGetInstanceProcAddr"sv,
+			"vkGetDeviceProcAddr"sv,
+			"vkCreateDevice"sv,
+			"vkDestroyDevice"sv,
+			"vkEnumerateInstanceExtensionProperties"sv,
+			"vkEnumerateInstanceLayerProperties"sv,
+		};
+
+		constexpr auto device_handles = std::array{"VkDevice"sv, "VkQueue"sv, "VkCommandBuffer"sv};
+		constexpr auto instance_handles = std::array{"VkInstance"sv, "VkPhysicalDevice"sv};
+		constexpr auto return_types = std::array{"void"sv, "VkResult"sv, "uint32_t"sv};
+
+		// commands in a feature or extension <require> block
+		constexpr std::size_t section_size = 16;
+
+		// every fourth command is instance level, like in vk.xml
+		bool is_synthetic_device_command(std::size_t index)
+		{
+			return index % 4 != 0;
+		}
+
+		std::string synthetic_command_name(std::size_t index)
+		{
+			return is_synthetic_device_command(index) ? fmt::format("vkCmdSynth{0:06}", index) : fmt::format("vkSynthInstance{0:06}", index);
+		}
+
+		std::string synthetic_feature_name(std::size_t index)
+		{
+			return fmt::format("VK_VERSION_{0}_{1}", 1 + index / 10, index % 10);
+		}
+
+		std::string synthetic_extension_name(std::size_t index)
+		{
+			return fmt::format("VK_SYNTH_extension_{0:06}", index);
+		}
+
+		void write_synthetic_command(fmt::memory_buffer &out, std::size_t index)
+		{
+			auto handle = is_synthetic_device_command(index) ? device_handles[index % device_handles.size()] : instance_handles[index % instance_handles.size()];
+
+			fmt::format_to(std::back_inserter(out), "        <command>\n");
+			fmt::format_to(std::back_inserter(out), "            <proto><type>{0}</type> <name>{1}</name></proto>\n", return_types[index % return_types.size()], synthetic_command_name(index));
+			fmt::format_to(std::back_inserter(out), "            <param><type>{0}</type> <name>handle</name></param>\n", handle);
+
+			for (std::size_t param = 1; param < 1 + index % 6; ++param)
+			{
+				switch ((index + param) % 5)
+				{
+				case 0:
+					fmt::format_to(std::back_inserter(out), "            <param><type>uint32_t</type> <name>value{0}</name></param>\n", param);
+					break;
+				case 1:
+					fmt::format_to(std::back_inserter(out), "            <param><type>uint64_t</type> <name>size{0}</name></param>\n", param);
+					break;
+				case 2:
+					fmt::format_to(std::back_inserter(out), "            <param><type>float</type> <name>weight{0}</name></param>\n", param);
+					break;
+				case 3:
+					fmt::format_to(std::back_inserter(out), "            <param>const <type>void</type>* <name>pData{0}</name></param>\n", param);
+					break;
+				default:
+					fmt::format_to(std::back_inserter(out), "            <param><type>uint32_t</type>* <name>pCount{0}</name></param>\n", param);
+					break;
+				}
+			}
+
+			fmt::format_to(std::back_inserter(out), "        </command>\n");
+		}
+
+		// a <require> block, attributes can be empty
+		void write_require(fmt::memory_buffer &out, std::string_view attributes, const std::vector<std::string> &commands, std::size_t first, std::size_t last)
+		{
+			fmt::format_to(std::back_inserter(out), "            <require{0}>\n", attributes);
+			for (auto i = first; i < last; ++i)
+				fmt::format_to(std::back_inserter(out), "                <command name=\"{0}\"/>\n", commands[i]);
+			fmt::format_to(std::back_inserter(out), "            </require>\n");
+		}
+
+		struct synthetic_alias
+		{
+			std::string name;
+			std::string target;
+		};
+
+		struct synthetic_extension
+		{
+			std::vector<std::string> commands;
+
+			// require blocks naming a dependency, for commands other extensions also require
+			std::vector<std::pair<std::string, std::string>> shared_commands;
+		};
+	}
+
+	registry_shape scale_registry_shape(const registry_shape &shape, std::size_t factor)
+	{
+		return registry_shape{
+			.commands = shape.commands * factor,
+			.aliases = shape.aliases * factor,
+			.alias_depth = shape.alias_depth * factor,
+			.features = shape.features * factor,
+			.extensions = shape.extensions * factor,
+			.shared_commands = shape.shared_commands,
+			.requirement_groups = shape.requirement_groups * factor,
+		};
+	}
+
+	void write_synthetic_registry(fmt::memory_buffer &out, const registry_shape &shape)
+	{
+		if (shape.features == 0)
+			throw std::runtime_error("A synthetic registry needs at least one feature");
+
+		// a bit under half the commands are core, the rest come from extensions that have commands
+		std::vector<std::size_t> command_extensions;
+		for (std::size_t i = 0; i < shape.extensions; ++i)
+			if (i % 10 < 7)
+				command_extensions.push_back(i);
+
+		auto core_commands = command_extensions.empty() ? shape.commands : shape.commands * 45 / 100;
+
+		std::vector<std::vector<std::string>> features(shape.features);
+		features[0].assign(begin(bootstrap_names), end(bootstrap_names));
+		for (std::size_t i = 0; i < core_commands; ++i)
+			features[i * shape.features / core_commands].emplace_back(synthetic_command_name(i));
+
+		std::vector<synthetic_extension> extensions(shape.extensions);
+		for (auto i = core_commands; i < shape.commands; ++i)
+			extensions[command_extensions[i % command_extensions.size()]].commands.emplace_back(synthetic_command_name(i));
+
+		// chains of aliases, chain c is 1 + c % alias_depth aliases long, each aliasing the previous one
+		std::vector<synthetic_alias> aliases;
+		for (std::size_t chain = 0; shape.commands > 0 && shape.alias_depth > 0 && aliases.size() < shape.aliases; ++chain)
+		{
+			auto target = synthetic_command_name(chain * 7 % shape.commands);
+			for (std::size_t level = 0; level <= chain % shape.alias_depth && aliases.size() < shape.aliases; ++level)
+			{
+				auto name = fmt::format("{0}Alias{1}_{2}", synthetic_command_name(chain * 7 % shape.commands), chain, level);
+				if (command_extensions.empty())
+					features[shape.features - 1].emplace_back(name);
+				else
+					extensions[command_extensions[(chain + level) % command_extensions.size()]].commands.emplace_back(name);
+
+				aliases.push_back({.name = name, .target = target});
+				target = std::move(name);
+			}
+		}
+
+		// some extension commands are also required by other extensions, under a dependency on the owning extension
+		// the number of requirement groups a shared command lands in is spread evenly from 2 up to requirement_groups
+		if (shape.requirement_groups > 1 && command_extensions.size() > 1 && shape.commands > core_commands)
+		{
+			auto extension_commands = shape.commands - core_commands;
+			for (std::size_t shared = 0; shared < shape.shared_commands; ++shared)
+			{
+				auto command = core_commands + shared * 13 % extension_commands;
+				auto owner = command % command_extensions.size();
+				auto spread = shape.shared_commands > 1 ? shared * (shape.requirement_groups - 2) / (shape.shared_commands - 1) : shape.requirement_groups - 2;
+				auto groups = std::min(2 + spread, command_extensions.size());
+
+				for (std::size_t group = 1; group < groups; ++group)
+				{
+					auto other = command_extensions[(owner + group) % command_extensions.size()];
+					extensions[other].shared_commands.emplace_back(synthetic_extension_name(command_extensions[owner]), synthetic_command_name(command));
+				}
+			}
+		}
+
+		fmt::format_to(std::back_inserter(out), R"(<?xml version="1.0" encoding="UTF-8"?>
+<registry>
+    <comment>
+Synthetic registry written by vgen-synth: {0} commands, {1} aliases up to {2} deep, {3} features, {4} extensions,
+{5} shared extension commands in up to {6} requirement groups.
+    </comment>
+    <types comment="Vulkan type definitions">
+        <type category="define">// Version of this file
+#define <name>VK_HEADER_VERSION</name> 250</type>
+    </types>
+    <commands comment="Vulkan command definitions">
+)",
+			shape.commands, shape.aliases, shape.alias_depth, shape.features, shape.extensions, shape.shared_commands, shape.requirement_groups);
+
+		fmt::format_to(std::back_inserter(out), "{0}", bootstrap_commands);
+
+		for (std::size_t i = 0; i < shape.commands; ++i)
+			write_synthetic_command(out, i);
+
+		for (const auto &alias : aliases)
+			fmt::format_to(std::back_inserter(out), "        <command name=\"{0}\" alias=\"{1}\"/>\n", alias.name, alias.target);
+
+		fmt::format_to(std::back_inserter(out), "    </commands>\n");
+
+		for (std::size_t i = 0; i < features.size(); ++i)
+		{
+			const auto &commands = features[i];
+			auto name = synthetic_feature_name(i);
+			fmt::format_to(std::back_inserter(out), "    <feature api=\"vulkan\" name=\"{0}\" number=\"{1}.{2}\" comment=\"Synthetic core API {1}.{2}\">\n", name, 1 + i / 10, i % 10);
+
+			for (std::size_t first = 0; first < commands.size(); first += section_size)
+				write_require(out, fmt::format(" comment=\"Commands {0} to {1}\"", first, std::min(first + section_size, commands.size()) - 1), commands, first, std::min(first + section_size, commands.size()));
+
+			fmt::format_to(std::back_inserter(out), "    </feature>\n");
+		}
+
+		fmt::format_to(std::back_inserter(out), "    <extensions comment=\"Vulkan extension interface definitions\">\n");
+
+		for (std::size_t i = 0; i < extensions.size(); ++i)
+		{
+			const auto &extension = extensions[i];
+			fmt::format_to(std::back_inserter(out), "        <extension name=\"{0}\" number=\"{1}\" type=\"{2}\" supported=\"{3}\">\n", synthetic_extension_name(i), i + 1, i % 3 == 0 ? "instance" : "device", i % 50 == 49 ? "disabled" : "vulkan");
+
+			// blocks alternate between no dependency, a dependency on the next extension, and one on a feature
+			for (std::size_t first = 0, block = 0; first < extension.commands.size(); first += section_size, ++block)
+			{
+				std::string attributes;
+				if ((i + block) % 5 == 1)
+					attributes = fmt::format(" extension=\"{0}\"", synthetic_extension_name((i + 1) % extensions.size()));
+				else if ((i + block) % 7 == 2)
+					attributes = fmt::format(" feature=\"{0}\"", synthetic_feature_name(i % features.size()));
+
+				write_require(out, attributes, extension.commands, first, std::min(first + section_size, extension.commands.size()));
+			}
+
+			for (const auto &[dependency, command] : extension.shared_commands)
+				write_require(out, fmt::format(" extension=\"{0}\"", dependency), {command}, 0, 1);
+
+			if (extension.commands.empty() && extension.shared_commands.empty())
+				fmt::format_to(std::back_inserter(out), "            <require>\n                <type name=\"VkSynthType{0:06}\"/>\n            </require>\n", i);
+
+			fmt::format_to(std::back_inserter(out), "        </extension>\n");
+		}
+
+		fmt::format_to(std::back_inserter(out), "    </extensions>\n</registry>\n");
+	}
+
+	namespace
+	{
+		constexpr auto dispatchable_handles = std::array{"VkInstance"sv, "VkPhysicalDevice"sv, "VkDevice"sv, "VkQueue"sv, "VkCommandBuffer"sv};
+		constexpr auto predefined_types = std::array{"VkResult"sv, "VkBool32"sv, "VkFlags"sv, "VkDeviceSize"sv, "VkDeviceAddress"sv};
+
+		bool is_identifier_char(char c)
+		{
+			return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+		}
+
+		// records every Vk type in a parameter list or return type and whether it is ever passed by value
+		void collect_types(std::string_view text, std::map<std::string, bool, std::less<>> &by_value)
+		{
+			for (std::size_t pos = 0; pos < text.size();)
+			{
+				if (!is_identifier_char(text[pos]))
+				{
+					++pos;
+					continue;
+				}
+
+				auto last = pos;
+				while (last < text.size() && is_identifier_char(text[last]))
+					++last;
+
+				auto name = text.substr(pos, last - pos);
+				if (name.starts_with("Vk"))
+				{
+					auto next = text.find_first_not_of(' ', last);
+					by_value[std::string(name)] |= next == std::string_view::npos || text[next] != '*';
+				}
+
+				pos = last;
+			}
+		}
+	}
+
+	void write_stand_in_vulkan_header(fmt::memory_buffer &out, std::string_view header_version, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands)
+	{
+		std::set<std::string> macros;
+		for (const auto &feature : features)
+			macros.emplace(feature.name);
+
+		for (const auto &[requirements, command] : extensions)
+			for (const auto &requirement : requirements)
+				for (auto &name : requirement_names(requirement))
+					macros.emplace(std::move(name));
+
+		std::map<std::string, const command_data *> sorted_commands;
+		std::map<std::string, bool, std::less<>> by_value;
+		for (const auto &[name, command] : commands)
+		{
+			sorted_commands.emplace(name, &command);
+			collect_types(command.prototype, by_value);
+			collect_types(command.params, by_value);
+		}
+
+		fmt::format_to(std::back_inserter(out), R"(/* stand-in for vulkan/vulkan.h written by vgen-synth, only fit for compiling a generated loader */
+#ifndef VULKAN_H_
+#define VULKAN_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VKAPI_ATTR
+#define VKAPI_CALL
+#define VKAPI_PTR
+
+#define VK_MAKE_API_VERSION(variant, major, minor, patch) ((((uint32_t)(variant)) << 29U) | (((uint32_t)(major)) << 22U) | (((uint32_t)(minor)) << 12U) | ((uint32_t)(patch)))
+#define VK_HEADER_VERSION {0}
+
+)",
+			header_version);
+
+		for (const auto &macro : macros)
+			fmt::format_to(std::back_inserter(out), "#define {0} 1\n", macro);
+
+		fmt::format_to(std::back_inserter(out), "\n");
+
+		for (const auto &feature : features)
+			if (auto version = feature_version(feature.name))
+				fmt::format_to(std::back_inserter(out), "#define VK_API_VERSION_{0}_{1} VK_MAKE_API_VERSION(0, {0}, {1}, 0)\n", version->major, version->minor);
+
+		fmt::format_to(std::back_inserter(out), R"(
+typedef enum VkResult
+{{
+	VK_SUCCESS = 0,
+	VK_NOT_READY = 1,
+	VK_INCOMPLETE = 5,
+	VK_ERROR_OUT_OF_HOST_MEMORY = -1,
+	VK_ERROR_INITIALIZATION_FAILED = -3,
+	VK_ERROR_EXTENSION_NOT_PRESENT = -7,
+	VK_ERROR_FEATURE_NOT_PRESENT = -8,
+	VK_ERROR_INCOMPATIBLE_DRIVER = -9,
+	VK_RESULT_MAX_ENUM = 0x7FFFFFFF
+}} VkResult;
+
+typedef uint32_t VkBool32;
+typedef uint32_t VkFlags;
+typedef uint64_t VkDeviceSize;
+typedef uint64_t VkDeviceAddress;
+
+)");
+
+		for (auto handle : dispatchable_handles)
+			fmt::format_to(std::back_inserter(out), "typedef struct {0}_T *{0};\n", handle);
+
+		for (const auto &[type, passed_by_value] : by_value)
+		{
+			if (std::find(begin(dispatchable_handles), end(dispatchable_handles), type) != end(dispatchable_handles) || std::find(begin(predefined_types), end(predefined_types), type) != end(predefined_types))
+				continue;
+
+			if (!passed_by_value)
+				fmt::format_to(std::back_inserter(out), "typedef struct {0} {0};\n", type);
+			else if (type.find("Flags") != std::string::npos || type.find("FlagBits") != std::string::npos)
+				fmt::format_to(std::back_inserter(out), "typedef VkFlags {0};\n", type);
+			else
+				fmt::format_to(std::back_inserter(out), "typedef uint64_t {0};\n", type);
+		}
+
+		fmt::format_to(std::back_inserter(out), "\ntypedef void (VKAPI_PTR *PFN_vkVoidFunction)(void);\n");
+
+		auto return_type = [](const command_data &command) {
+			return std::string_view(command.prototype).substr(0, command.prototype.rfind(command.name));
+		};
+
+		for (const auto &[name, command] : sorted_commands)
+			fmt::format_to(std::back_inserter(out), "typedef {0}(VKAPI_PTR *PFN_{1})({2});\n", return_type(*command), name, command->params.empty() ? "void"sv : command->params);
+
+		fmt::format_to(std::back_inserter(out), "\n#ifndef VK_NO_PROTOTYPES\n");
+
+		for (const auto &[name, command] : sorted_commands)
+			fmt::format_to(std::back_inserter(out), "VKAPI_ATTR {0}VKAPI_CALL {1}({2});\n", return_type(*command), name, command->params.empty() ? "void"sv : command->params);
+
+		fmt::format_to(std::back_inserter(out), "#endif\n\n#endif\n");
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vgen.hpp>
+
+#include <fmt/format.h>
+
+#include <cstddef>
+
+namespace vgen
+{
+	// the size of a synthetic registry, the defaults are roughly the shape of vk.xml for Vulkan 1.3
+	struct registry_shape
+	{
+		// commands with a prototype, the few the loader itself calls are always added on top
+		std::size_t commands = 460;
+
+		// alias commands, arranged in chains of aliases of aliases up to alias_depth long
+		std::size_t aliases = 200;
+		std::size_t alias_depth = 2;
+
+		std::size_t features = 4;
+		std::size_t extensions = 300;
+
+		// extension commands that more than one extension requires
+		// the most extensions requiring one command, which is the most requirement groups the command lands in
+		std::size_t shared_commands = 20;
+		std::size_t requirement_groups = 3;
+	};
+
+	// multiplies every count of the shape, including alias depth and requirement groups
+	// shared commands are left alone, their require blocks already grow with the requirement groups
+	registry_shape scale_registry_shape(const registry_shape &shape, std::size_t factor);
+
+	// writes a vk.xml with the structure read_commands, read_features and read_extensions expect
+	// the output only depends on the shape, so the same shape always gives the same registry
+	void write_synthetic_registry(fmt::memory_buffer &out, const registry_shape &shape);
+
+	// writes a stand-in for vulkan/vulkan.h declaring what a loader generated from these commands needs to compile:
+	// feature and extension macros, the types used by the commands, their PFN typedefs, and their prototypes
+	// types are guessed from their use, dispatchable handles are pointers, other types passed by value are 64 bit handles or flags
+	void write_stand_in_vulkan_header(fmt::memory_buffer &out, std::string_view header_version, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands);
+}
@@ -0,0 +1,322 @@
+#include <vgen.hpp>
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+#if !defined(VGEN_BENCH_REGISTRY)
+#define VGEN_BENCH_REGISTRY "vk.xml"
+#endif
+
+// count allocations of every phase
+void *operator new(std::size_t size)
+{
+	if (auto ptr = vgen::counted_allocate(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+namespace
+{
+	struct phase_result
+	{
+		std::string name;
+		std::vector<double> seconds = {}; // one sample per measured iteration, the time of a single run
+		std::size_t repeats = 1;         // runs timed together in each sample
+		std::size_t processed_bytes = 0; // registry bytes read or loader bytes written by one run
+		std::size_t allocations = 0;     // per run
+		std::size_t allocated_bytes = 0; // per run
+		std::size_t peak_bytes = 0;      // most bytes live at once during a run, above what was live before it
+	};
+
+	double min_seconds(const phase_result &result)
+	{
+		return *std::min_element(begin(result.seconds), end(result.seconds));
+	}
+
+	double median_seconds(const phase_result &result)
+	{
+		auto seconds = result.seconds;
+		auto middle = begin(seconds) + std::ssize(seconds) / 2;
+		std::nth_element(begin(seconds), middle, end(seconds));
+		return *middle;
+	}
+
+	double bytes_per_second(const phase_result &result)
+	{
+		auto seconds = median_seconds(result);
+		return seconds > 0 ? static_cast<double>(result.processed_bytes) / seconds : 0;
+	}
+
+	// runs fn warmup times, then once counting its allocations, then iterations samples of repeated runs
+	// a phase faster than min_sample is repeated within every sample until the sample lasts about that long, the
+	// phases of a small registry run in microseconds, which the clock does not resolve well enough on its own
+	// the value fn returns is kept in output, the values of a sample are destroyed outside of the timed region
+	template <typename T, typename Fn>
+	phase_result run_phase(std::string name, std::size_t warmup, std::size_t iterations, std::chrono::duration<double> min_sample, T &output, Fn fn)
+	{
+		phase_result result{.name = std::move(name)};
+		result.seconds.reserve(iterations);
+
+		for (std::size_t i = 0; i < warmup; ++i)
+			output = fn();
+
+		vgen::reset_allocation_peak();
+		auto before = vgen::get_allocation_totals();
+
+		auto start = std::chrono::steady_clock::now();
+		output = fn();
+		auto once = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+		auto after = vgen::get_allocation_totals();
+		result.allocations = after.count - before.count;
+		result.allocated_bytes = after.bytes - before.bytes;
+		result.peak_bytes = after.peak - before.live;
+
+		constexpr std::size_t max_repeats = 100000;
+		if (once < min_sample)
+			result.repeats = once.count() > 0 ? std::min(static_cast<std::size_t>(std::ceil(min_sample / once)), max_repeats) : max_repeats;
+
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			std::vector<T> values;
+			values.reserve(result.repeats);
+
+			start = std::chrono::steady_clock::now();
+			for (std::size_t run = 0; run < result.repeats; ++run)
+				values.push_back(fn());
+			auto stop = std::chrono::steady_clock::now();
+
+			result.seconds.push_back(std::chrono::duration<double>(stop - start).count() / static_cast<double>(result.repeats));
+			output = std::move(values.back());
+		}
+
+		return result;
+	}
+
+	std::string read_file(const fs::path &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("Unable to read " + path.string());
+
+		return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+	}
+
+	std::size_t total_size(const std::vector<vgen::generated_file> &files)
+	{
+		std::size_t size = 0;
+		for (const auto &file : files)
+			size += file.contents.size();
+
+		return size;
+	}
+
+	void write_table(fmt::memory_buffer &out, const std::vector<phase_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{0:<24} {1:>10} {2:>10} {3:>8} {4:>10} {5:>10} {6:>12} {7:>12}\n", "phase", "min ms", "median ms", "repeats", "MiB/s", "allocs", "alloc KiB", "peak KiB");
+
+		for (const auto &result : results)
+		{
+			fmt::format_to(std::back_inserter(out), "{0:<24} {1:>10.3f} {2:>10.3f} {3:>8} {4:>10.1f} {5:>10} {6:>12.1f} {7:>12.1f}\n",
+				result.name,
+				min_seconds(result) * 1000,
+				median_seconds(result) * 1000,
+				result.repeats,
+				bytes_per_second(result) / (1024 * 1024),
+				result.allocations,
+				static_cast<double>(result.allocated_bytes) / 1024,
+				static_cast<double>(result.peak_bytes) / 1024);
+		}
+	}
+
+	void write_json(fmt::memory_buffer &out, const std::string &registry, std::size_t registry_bytes, std::size_t iterations, const std::vector<phase_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{{\n");
+		fmt::format_to(std::back_inserter(out), "\t\"registry\": \"{0}\",\n", vgen::json_escape(registry));
+		fmt::format_to(std::back_inserter(out), "\t\"registry_bytes\": {0},\n", registry_bytes);
+		fmt::format_to(std::back_inserter(out), "\t\"iterations\": {0},\n", iterations);
+		fmt::format_to(std::back_inserter(out), "\t\"phases\": [\n");
+
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const auto &result = results[i];
+			fmt::format_to(std::back_inserter(out),
+				"\t\t{{\"name\": \"{0}\", \"min_seconds\": {1}, \"median_seconds\": {2}, \"repeats\": {3}, \"bytes\": {4}, \"bytes_per_second\": {5}, \"allocations\": {6}, \"allocated_bytes\": {7}, \"peak_bytes\": {8}}}{9}\n",
+				result.name,
+				min_seconds(result),
+				median_seconds(result),
+				result.repeats,
+				result.processed_bytes,
+				bytes_per_second(result),
+				result.allocations,
+				result.allocated_bytes,
+				result.peak_bytes,
+				i + 1 < results.size() ? "," : "");
+		}
+
+		fmt::format_to(std::back_inserter(out), "\t]\n}}\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		cxxopts::Options options("vgen-bench", "Per phase benchmark of the Vulkan loader generator");
+		options.positional_help("[path to vk.xml]");
+
+		// clang-format off
+		options.add_options()
+			("h,help", "Show this help")
+			("i,in", "path to Vulkan API Registry file (vk.xml)", cxxopts::value<std::string>()->default_value(VGEN_BENCH_REGISTRY))
+			("n,iterations", "measured samples of each phase", cxxopts::value<std::size_t>()->default_value("20"))
+			("warmup", "unmeasured runs of each phase before the measured ones", cxxopts::value<std::size_t>()->default_value("2"))
+			("min-sample-ms", "repeat a phase within each measured run until it lasts this long, times are per repeat", cxxopts::value<double>()->default_value("10"))
+			("json", "also write the results as JSON to this file", cxxopts::value<std::string>());
+		// clang-format on
+
+		options.parse_positional({"in"s});
+
+		auto parsed_options = options.parse(argc, argv);
+		if (parsed_options.count("help"))
+		{
+			fmt::print("{0}", options.help());
+			return 0;
+		}
+
+		auto iterations = parsed_options["iterations"].as<std::size_t>();
+		auto warmup = parsed_options["warmup"].as<std::size_t>();
+		auto min_sample = std::chrono::duration<double, std::milli>(parsed_options["min-sample-ms"].as<double>());
+		if (iterations == 0)
+		{
+			fmt::print(stderr, "ERROR: --iterations must be at least 1\n");
+			return 1;
+		}
+
+		pugi::set_memory_management_functions(vgen::counted_allocate, vgen::counted_deallocate);
+
+		// the registry is read once up front so the document phase measures parsing rather than disk access
+		auto in_file = parsed_options["in"].as<std::string>();
+		auto registry = read_file(in_file);
+
+		std::vector<phase_result> results;
+
+		std::unique_ptr<pugi::xml_document> doc;
+		// clang-format off
+		results.push_back(run_phase("load_document", warmup, iterations, min_sample, doc, [&] {
+			auto document = std::make_unique<pugi::xml_document>();
+			if (auto result = document->load_buffer(registry.data(), registry.size(), pugi::parse_default | pugi::parse_trim_pcdata); !result)
+				throw std::runtime_error(in_file + ": "s + result.description());
+			return document;
+		}));
+		// clang-format on
+		results.back().processed_bytes = registry.size();
+
+		std::string version;
+		results.push_back(run_phase("read_header_version", warmup, iterations, min_sample, version, [&] { return vgen::read_vulkan_header_version(*doc); }));
+
+		vgen::command_map commands;
+		results.push_back(run_phase("read_commands", warmup, iterations, min_sample, commands, [&] { return vgen::read_commands(*doc); }));
+		results.back().processed_bytes = registry.size();
+
+		std::vector<vgen::feature_data> features;
+		results.push_back(run_phase("read_features", warmup, iterations, min_sample, features, [&] { return vgen::read_features(*doc); }));
+		results.back().processed_bytes = registry.size();
+
+		vgen::extension_map extensions;
+		results.push_back(run_phase("read_extensions", warmup, iterations, min_sample, extensions, [&] { return vgen::read_extensions(*doc); }));
+		results.back().processed_bytes = registry.size();
+
+		vgen::emission_plan plan;
+		results.push_back(run_phase("build_emission_plan", warmup, iterations, min_sample, plan, [&] { return vgen::build_emission_plan(version, features, extensions, commands); }));
+
+		std::vector<vgen::plan_block> device_blocks;
+		results.push_back(run_phase("get_device_blocks", warmup, iterations, min_sample, device_blocks, [&] { return vgen::get_device_blocks(plan.blocks); }));
+
+		// clang-format off
+		std::string header;
+		results.push_back(run_phase("write_header", warmup, iterations, min_sample, header, [&] {
+			fmt::memory_buffer out;
+			vgen::write_header(out, plan);
+			return to_string(out);
+		}));
+		results.back().processed_bytes = header.size();
+
+		std::string source;
+		results.push_back(run_phase("write_source", warmup, iterations, min_sample, source, [&] {
+			fmt::memory_buffer out;
+			vgen::write_source(out, plan);
+			return to_string(out);
+		}));
+		results.back().processed_bytes = source.size();
+		// clang-format on
+
+		std::vector<vgen::generated_file> files;
+		results.push_back(run_phase("generate_loader", warmup, iterations, min_sample, files, [&] { return vgen::generate_loader(plan); }));
+		results.back().processed_bytes = total_size(files);
+
+		fmt::print("{0}: {1} bytes, {2} commands, {3} features, {4} extension groups, {5} iterations\n\n", in_file, registry.size(), commands.size(), features.size(), extensions.size(), iterations);
+
+		fmt::memory_buffer table;
+		write_table(table, results);
+		fmt::print("{0}", to_string(table));
+
+		if (parsed_options.count("json"))
+		{
+			auto path = fs::path(parsed_options["json"].as<std::string>());
+
+			fmt::memory_buffer json;
+			write_json(json, in_file, registry.size(), iterations, results);
+			std::ofstream(path) << to_string(json);
+		}
+	}
+	catch (std::exception &e)
+	{
+		fmt::print(stderr, "{0}\n", e.what());
+		return 1;
+	}
+}
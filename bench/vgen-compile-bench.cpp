@@ -0,0 +1,330 @@
+#include <synth.hpp>
+#include <vgen.hpp>
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+#if !defined(VGEN_BENCH_CC)
+#define VGEN_BENCH_CC "cc"
+#endif
+
+#if !defined(VGEN_BENCH_CXX)
+#define VGEN_BENCH_CXX "c++"
+#endif
+
+namespace
+{
+	// one way of generating the loader, and the defines its users compile it with
+	struct compile_variant
+	{
+		std::string name;
+		vgen::generator_options options;
+		std::vector<std::string> defines;
+
+		// with separate variants, the one file set of the output that is compiled
+		std::string directory = {};
+	};
+
+	// the C compiler builds the loader sources, the C++ compiler the module units
+	struct compilers
+	{
+		std::string c;
+		std::string cxx;
+	};
+
+	struct compile_result
+	{
+		std::string name;
+		std::size_t sources = 0;
+
+		// summed over the loader sources, times are the fastest of all runs
+		double preprocess_seconds = 0;
+		double compile_seconds = 0;
+		std::size_t preprocessed_bytes = 0;
+		std::size_t object_bytes = 0;
+		std::size_t symbols = 0;
+
+		// a translation unit that only includes vulkan_loader.h, the cost every user of the loader pays
+		double include_seconds = 0;
+	};
+
+	std::vector<compile_variant> get_compile_variants()
+	{
+		return {
+			{.name = "both", .options = {}, .defines = {}},
+			{.name = "both-no-prototypes", .options = {}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "prototypes", .options = {.variant = vgen::loader_variant::prototypes}, .defines = {}},
+			{.name = "struct", .options = {.variant = vgen::loader_variant::api_struct}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "shards-4", .options = {.shards = 4}, .defines = {}},
+			{.name = "split-headers", .options = {.split_headers = true}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "table", .options = {.init = vgen::init_mode::table}, .defines = {}},
+			{.name = "table-no-prototypes", .options = {.init = vgen::init_mode::table}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "separate-prototypes", .options = {.separate_variants = true}, .defines = {}, .directory = "prototypes"},
+			{.name = "separate-struct", .options = {.separate_variants = true}, .defines = {"VK_NO_PROTOTYPES"}, .directory = "struct"},
+			{.name = "cpp-module", .options = {.cpp_module = true}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "proc-lookup", .options = {.init = vgen::init_mode::table, .proc_lookup = true}, .defines = {}},
+			{.name = "proc-lookup-no-prototypes", .options = {.init = vgen::init_mode::table, .proc_lookup = true}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "lazy", .options = {.init = vgen::init_mode::lazy}, .defines = {}},
+			{.name = "device-dispatch", .options = {.device_dispatch = true}, .defines = {}},
+			{.name = "inline-dispatch", .options = {.inline_dispatch = true}, .defines = {}},
+			{.name = "not-present-stubs", .options = {.not_present_stubs = true}, .defines = {}},
+			{.name = "thread-safe", .options = {.thread_safe = true}, .defines = {}},
+			{.name = "ex", .options = {.load_enabled_extensions = true}, .defines = {}},
+			{.name = "ex-no-prototypes", .options = {.load_enabled_extensions = true}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "alias-slots", .options = {.share_alias_slots = true}, .defines = {}},
+			{.name = "alias-slots-no-prototypes", .options = {.share_alias_slots = true}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "availability", .options = {.init = vgen::init_mode::table, .availability = true}, .defines = {}},
+			{.name = "availability-no-prototypes", .options = {.init = vgen::init_mode::table, .availability = true}, .defines = {"VK_NO_PROTOTYPES"}},
+			{.name = "async-device-load", .options = {.async_device_load = true}, .defines = {}},
+		};
+	}
+
+	std::string read_file(const fs::path &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("Unable to read " + path.string());
+
+		return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+	}
+
+	void write_file(const fs::path &path, std::string_view contents)
+	{
+		fs::create_directories(path.parent_path());
+		std::ofstream(path, std::ios::binary) << contents;
+	}
+
+	// runs a shell command, throws if it fails, returns the fastest wall time of runs
+	double time_command(const std::string &command, std::size_t runs)
+	{
+		auto best = std::numeric_limits<double>::max();
+
+		for (std::size_t i = 0; i < runs; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			auto status = std::system(command.c_str());
+			auto stop = std::chrono::steady_clock::now();
+
+			if (status != 0)
+				throw std::runtime_error(fmt::format("Command failed ({0}): {1}", status, command));
+
+			best = std::min(best, std::chrono::duration<double>(stop - start).count());
+		}
+
+		return best;
+	}
+
+	std::size_t count_symbols(const fs::path &object)
+	{
+		auto listing = object;
+		listing.replace_extension(".syms");
+		if (std::system(fmt::format(R"(nm --defined-only "{0}" > "{1}")", object.string(), listing.string()).c_str()) != 0)
+			return 0;
+
+		auto symbols = read_file(listing);
+		return static_cast<std::size_t>(std::count(begin(symbols), end(symbols), '\n'));
+	}
+
+	bool is_module_unit(const fs::path &source)
+	{
+		return source.extension() == ".cppm" || source.extension() == ".cpp";
+	}
+
+	compile_result compile_loader(const compile_variant &variant, const std::vector<vgen::generated_file> &files, const fs::path &dir, const compilers &compiler, const fs::path &vulkan_include, std::size_t runs)
+	{
+		compile_result result{.name = variant.name};
+
+		for (const auto &file : files)
+			write_file(dir / file.name, file.contents);
+
+		const auto loader_dir = dir / variant.directory;
+		write_file(loader_dir / "include_only.c", "#include <vulkan_loader.h>\n\nint include_only(void)\n{\n\treturn 0;\n}\n");
+
+		std::string flags = fmt::format(R"(-I"{0}" -I"{1}")", vulkan_include.string(), loader_dir.string());
+		for (const auto &define : variant.defines)
+			flags += fmt::format(" -D{0}", define);
+
+		std::vector<fs::path> sources;
+		for (const auto &file : files)
+		{
+			auto source = dir / file.name;
+			if (fs::path(file.name).parent_path() == fs::path(variant.directory) && (source.extension() == ".c" || is_module_unit(source)))
+				sources.emplace_back(std::move(source));
+		}
+
+		// the module interface is built before the implementation unit importing it
+		std::stable_partition(begin(sources), end(sources), [](const auto &source) { return source.extension() == ".cppm"; });
+
+		for (const auto &source : sources)
+		{
+			auto preprocessed = source;
+			preprocessed.replace_extension(".i");
+
+			auto object = source;
+			object.replace_extension(".o");
+
+			// g++ keeps compiled module interfaces in gcm.cache under the working directory
+			auto command = is_module_unit(source) ? fmt::format(R"(cd "{0}" && {1} -x c++)", loader_dir.string(), compiler.cxx) : compiler.c;
+
+			result.preprocess_seconds += time_command(fmt::format(R"({0} {1} -E "{2}" -o "{3}")", command, flags, source.string(), preprocessed.string()), runs);
+			result.compile_seconds += time_command(fmt::format(R"({0} {1} -c "{2}" -o "{3}")", command, flags, source.string(), object.string()), runs);
+
+			++result.sources;
+			result.preprocessed_bytes += fs::file_size(preprocessed);
+			result.object_bytes += fs::file_size(object);
+			result.symbols += count_symbols(object);
+		}
+
+		result.include_seconds = time_command(fmt::format(R"({0} {1} -c "{2}" -o "{3}")", compiler.c, flags, (loader_dir / "include_only.c").string(), (loader_dir / "include_only.o").string()), runs);
+
+		return result;
+	}
+
+	void write_table(fmt::memory_buffer &out, const std::vector<compile_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{0:<26} {1:>7} {2:>13} {3:>11} {4:>12} {5:>12} {6:>8} {7:>11}\n", "variant", "sources", "preprocess ms", "compile ms", "preprocessed", "object bytes", "symbols", "include ms");
+
+		for (const auto &result : results)
+		{
+			fmt::format_to(std::back_inserter(out), "{0:<26} {1:>7} {2:>13.1f} {3:>11.1f} {4:>12} {5:>12} {6:>8} {7:>11.1f}\n",
+				result.name,
+				result.sources,
+				result.preprocess_seconds * 1000,
+				result.compile_seconds * 1000,
+				result.preprocessed_bytes,
+				result.object_bytes,
+				result.symbols,
+				result.include_seconds * 1000);
+		}
+	}
+
+	void write_json(fmt::memory_buffer &out, const std::string &compiler, const std::vector<compile_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{{\n\t\"compiler\": \"{0}\",\n\t\"variants\": [\n", vgen::json_escape(compiler));
+
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const auto &result = results[i];
+			fmt::format_to(std::back_inserter(out),
+				"\t\t{{\"name\": \"{0}\", \"sources\": {1}, \"preprocess_seconds\": {2}, \"compile_seconds\": {3}, \"preprocessed_bytes\": {4}, \"object_bytes\": {5}, \"symbols\": {6}, \"include_seconds\": {7}}}{8}\n",
+				result.name,
+				result.sources,
+				result.preprocess_seconds,
+				result.compile_seconds,
+				result.preprocessed_bytes,
+				result.object_bytes,
+				result.symbols,
+				result.include_seconds,
+				i + 1 < results.size() ? "," : "");
+		}
+
+		fmt::format_to(std::back_inserter(out), "\t]\n}}\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		cxxopts::Options options("vgen-compile-bench", "Compiles the loader generated in each output mode and reports its build cost");
+
+		// clang-format off
+		options.add_options()
+			("h,help", "Show this help")
+			("i,in", "path to Vulkan API Registry file (vk.xml), a synthetic registry is used when not given", cxxopts::value<std::string>())
+			("s,scale", "scale of the synthetic registry", cxxopts::value<std::size_t>()->default_value("1"))
+			("vulkan-include", "directory holding vulkan/vulkan.h, a stand-in is written from the registry when not given", cxxopts::value<std::string>())
+			("cc", "C compiler", cxxopts::value<std::string>()->default_value(VGEN_BENCH_CC))
+			("cflags", "flags passed to every compile", cxxopts::value<std::string>()->default_value("-O2"))
+			("cxx", "C++ compiler for the module units of the cpp-module variant", cxxopts::value<std::string>()->default_value(VGEN_BENCH_CXX))
+			("cxxflags", "flags passed to every module unit compile, including those enabling modules", cxxopts::value<std::string>()->default_value("-O2 -std=c++20 -fmodules-ts"))
+			("work-dir", "directory for the generated and compiled files", cxxopts::value<std::string>()->default_value("vgen-compile-bench"))
+			("n,runs", "compiles of each file, the fastest counts", cxxopts::value<std::size_t>()->default_value("3"))
+			("json", "also write the results as JSON to this file", cxxopts::value<std::string>());
+		// clang-format on
+
+		auto parsed_options = options.parse(argc, argv);
+		if (parsed_options.count("help"))
+		{
+			fmt::print("{0}", options.help());
+			return 0;
+		}
+
+		std::string registry;
+		if (parsed_options.count("in"))
+			registry = read_file(parsed_options["in"].as<std::string>());
+		else
+		{
+			fmt::memory_buffer out;
+			vgen::write_synthetic_registry(out, vgen::scale_registry_shape(vgen::registry_shape{}, parsed_options["scale"].as<std::size_t>()));
+			registry = to_string(out);
+		}
+
+		pugi::xml_document doc;
+		if (auto result = doc.load_buffer(registry.data(), registry.size(), pugi::parse_default | pugi::parse_trim_pcdata); !result)
+			throw std::runtime_error(result.description());
+
+		auto version = vgen::read_vulkan_header_version(doc);
+		auto commands = vgen::read_commands(doc);
+		auto features = vgen::read_features(doc);
+		auto extensions = vgen::read_extensions(doc);
+		auto plan = vgen::build_emission_plan(version, features, extensions, commands);
+
+		auto work_dir = fs::absolute(parsed_options["work-dir"].as<std::string>());
+		compilers compiler{
+			.c = fmt::format("{0} {1}", parsed_options["cc"].as<std::string>(), parsed_options["cflags"].as<std::string>()),
+			.cxx = fmt::format("{0} {1}", parsed_options["cxx"].as<std::string>(), parsed_options["cxxflags"].as<std::string>()),
+		};
+		auto runs = std::max<std::size_t>(parsed_options["runs"].as<std::size_t>(), 1);
+
+		fs::path vulkan_include;
+		if (parsed_options.count("vulkan-include"))
+			vulkan_include = fs::absolute(parsed_options["vulkan-include"].as<std::string>());
+		else
+		{
+			vulkan_include = work_dir / "include";
+
+			fmt::memory_buffer header;
+			vgen::write_stand_in_vulkan_header(header, version, features, extensions, commands);
+			write_file(vulkan_include / "vulkan" / "vulkan.h", to_string(header));
+		}
+
+		fmt::print("{0}: {1} commands, compiling with {2}, fastest of {3} runs\n\n", parsed_options.count("in") ? parsed_options["in"].as<std::string>() : "synthetic registry"s, commands.size(), compiler.c, runs);
+
+		std::vector<compile_result> results;
+		for (const auto &variant : get_compile_variants())
+			results.emplace_back(compile_loader(variant, vgen::generate_loader(plan, variant.options), work_dir / variant.name, compiler, vulkan_include, runs));
+
+		fmt::memory_buffer table;
+		write_table(table, results);
+		fmt::print("{0}", to_string(table));
+
+		if (parsed_options.count("json"))
+		{
+			fmt::memory_buffer json;
+			write_json(json, compiler.c, results);
+			std::ofstream(parsed_options["json"].as<std::string>()) << to_string(json);
+		}
+	}
+	catch (std::exception &e)
+	{
+		fmt::print(stderr, "{0}\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,300 @@
+#include <synth.hpp>
+#include <vgen.hpp>
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+#if !defined(VGEN_BENCH_CC)
+#define VGEN_BENCH_CC "cc"
+#endif
+
+namespace
+{
+	struct dispatch_variant
+	{
+		std::string name;
+		vgen::generator_options options;
+	};
+
+	struct dispatch_result
+	{
+		std::string name;
+		double call_seconds = 0; // per call, the fastest of all runs
+	};
+
+	std::vector<dispatch_variant> get_dispatch_variants()
+	{
+		return {
+			{.name = "wrapper", .options = {.variant = vgen::loader_variant::prototypes}},
+			{.name = "inline", .options = {.variant = vgen::loader_variant::prototypes, .inline_dispatch = true}},
+			{.name = "lazy-wrapper", .options = {.variant = vgen::loader_variant::prototypes, .init = vgen::init_mode::lazy}},
+			{.name = "lazy-inline", .options = {.variant = vgen::loader_variant::prototypes, .init = vgen::init_mode::lazy, .inline_dispatch = true}},
+		};
+	}
+
+	void write_file(const fs::path &path, std::string_view contents)
+	{
+		fs::create_directories(path.parent_path());
+		std::ofstream(path, std::ios::binary) << contents;
+	}
+
+	void run_command(const std::string &command)
+	{
+		if (auto status = std::system(command.c_str()); status != 0)
+			throw std::runtime_error(fmt::format("Command failed ({0}): {1}", status, command));
+	}
+
+	// the first device command in plan order stands in for a hot command like vkCmdDraw
+	const vgen::command_data &get_hot_command(const vgen::emission_plan &plan)
+	{
+		for (const auto &block : plan.device_blocks)
+			for (const auto &section : block.sections)
+				for (auto command : section.commands)
+					if (command->name != "vkGetDeviceProcAddr"sv)
+						return *command;
+
+		throw std::runtime_error("The registry has no device commands");
+	}
+
+	// a program calling the hot command in a loop, the stand-in driver hands out a stub that only counts its calls
+	// the synthetic registry only passes scalars and pointers, so a 0 fits every argument and return value
+	void write_driver(fmt::memory_buffer &out, const vgen::command_data &command)
+	{
+		auto return_type = std::string_view(command.prototype).substr(0, command.prototype.rfind(command.name));
+		auto arguments = command.param_names.empty() ? 0 : std::count(begin(command.param_names), end(command.param_names), ',') + 1;
+
+		fmt::format_to(std::back_inserter(out), R"(#define _POSIX_C_SOURCE 199309L
+#include <vulkan_loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static size_t calls;
+
+static void VKAPI_PTR stub(void)
+{{
+}}
+
+static {0}VKAPI_PTR hot_stub({1})
+{{
+	++calls;
+{2}}}
+
+static PFN_vkVoidFunction VKAPI_PTR get_device_proc(VkDevice device, const char *name);
+
+static PFN_vkVoidFunction VKAPI_PTR get_instance_proc(VkInstance instance, const char *name)
+{{
+	(void)instance;
+
+	if (strcmp(name, "vkGetInstanceProcAddr") == 0)
+		return (PFN_vkVoidFunction)get_instance_proc;
+	if (strcmp(name, "vkGetDeviceProcAddr") == 0)
+		return (PFN_vkVoidFunction)get_device_proc;
+	if (strcmp(name, "{3}") == 0)
+		return (PFN_vkVoidFunction)hot_stub;
+
+	return stub;
+}}
+
+static PFN_vkVoidFunction VKAPI_PTR get_device_proc(VkDevice device, const char *name)
+{{
+	(void)device;
+	return get_instance_proc(0, name);
+}}
+
+static double seconds(void)
+{{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}}
+
+int main(int argc, char *argv[])
+{{
+	static char instance, device;
+	double best = 1e30;
+	size_t i, calls_per_run = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+	int run, runs = argc > 2 ? atoi(argv[2]) : 1;
+
+	vgen_init_vulkan_loader(get_instance_proc);
+	vgen_load_instance_procs((VkInstance)&instance);
+	vgen_load_device_procs((VkDevice)&device);
+
+	for (run = 0; run < runs; ++run)
+	{{
+		double start = seconds(), elapsed;
+		for (i = 0; i < calls_per_run; ++i)
+			{3}()",
+			return_type, command.params.empty() ? "void"sv : command.params, command.returns_void ? "" : "\treturn 0;\n", command.name);
+
+		for (std::ptrdiff_t i = 0; i < arguments; ++i)
+			fmt::format_to(std::back_inserter(out), "{0}0", i == 0 ? "" : ", ");
+
+		fmt::format_to(std::back_inserter(out), R"();
+		elapsed = seconds() - start;
+		best = elapsed < best ? elapsed : best;
+	}}
+
+	if (calls != calls_per_run * (size_t)runs)
+		return 1;
+
+	printf("%.12f\n", best / (double)calls_per_run);
+	return 0;
+}}
+)");
+	}
+
+	dispatch_result run_loader(const dispatch_variant &variant, const std::vector<vgen::generated_file> &files, std::string_view driver, const fs::path &dir, const std::string &compiler, const fs::path &vulkan_include, std::size_t calls, std::size_t runs)
+	{
+		for (const auto &file : files)
+			write_file(dir / file.name, file.contents);
+
+		write_file(dir / "driver.c", driver);
+
+		// separate translation units, as in an application, so the wrappers can't be inlined into the loop
+		std::string sources;
+		for (const auto &file : files)
+			if (fs::path(file.name).extension() == ".c")
+				sources += fmt::format(R"( "{0}")", (dir / file.name).string());
+
+		auto program = dir / "dispatch";
+		auto timings = dir / "dispatch.txt";
+		run_command(fmt::format(R"({0} -DNDEBUG -I"{1}" -I"{2}"{3} "{4}" -o "{5}")", compiler, vulkan_include.string(), dir.string(), sources, (dir / "driver.c").string(), program.string()));
+		run_command(fmt::format(R"("{0}" {1} {2} > "{3}")", program.string(), calls, runs, timings.string()));
+
+		dispatch_result result{.name = variant.name};
+
+		auto file = std::fopen(timings.string().c_str(), "r");
+		if (!file)
+			throw std::runtime_error("Unable to read " + timings.string());
+
+		auto read = std::fscanf(file, "%lf", &result.call_seconds);
+		std::fclose(file);
+
+		if (read != 1)
+			throw std::runtime_error("Unexpected output in " + timings.string());
+
+		return result;
+	}
+
+	void write_table(fmt::memory_buffer &out, const std::vector<dispatch_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{0:<14} {1:>12} {2:>12}\n", "variant", "ns per call", "vs wrapper");
+
+		for (const auto &result : results)
+		{
+			fmt::format_to(std::back_inserter(out), "{0:<14} {1:>12.3f} {2:>+12.3f}\n",
+				result.name,
+				result.call_seconds * 1e9,
+				(result.call_seconds - results.front().call_seconds) * 1e9);
+		}
+	}
+
+	void write_json(fmt::memory_buffer &out, const std::string &compiler, std::string_view command, const std::vector<dispatch_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{{\n\t\"compiler\": \"{0}\",\n\t\"command\": \"{1}\",\n\t\"variants\": [\n", vgen::json_escape(compiler), command);
+
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const auto &result = results[i];
+			fmt::format_to(std::back_inserter(out), "\t\t{{\"name\": \"{0}\", \"call_seconds\": {1}}}{2}\n", result.name, result.call_seconds, i + 1 < results.size() ? "," : "");
+		}
+
+		fmt::format_to(std::back_inserter(out), "\t]\n}}\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		cxxopts::Options options("vgen-dispatch-bench", "Times a call through the prototype loader generated with and without inline dispatch");
+
+		// clang-format off
+		options.add_options()
+			("h,help", "Show this help")
+			("cc", "C compiler", cxxopts::value<std::string>()->default_value(VGEN_BENCH_CC))
+			("cflags", "flags passed to every compile", cxxopts::value<std::string>()->default_value("-O2"))
+			("work-dir", "directory for the generated and compiled files", cxxopts::value<std::string>()->default_value("vgen-dispatch-bench"))
+			("calls", "calls of the command in each run", cxxopts::value<std::size_t>()->default_value("10000000"))
+			("n,runs", "runs of each loader, the fastest counts", cxxopts::value<std::size_t>()->default_value("5"))
+			("json", "also write the results as JSON to this file", cxxopts::value<std::string>());
+		// clang-format on
+
+		auto parsed_options = options.parse(argc, argv);
+		if (parsed_options.count("help"))
+		{
+			fmt::print("{0}", options.help());
+			return 0;
+		}
+
+		// the stand-in driver passes zeroed arguments, which only fits the scalar parameters of the synthetic registry
+		fmt::memory_buffer registry;
+		vgen::write_synthetic_registry(registry, vgen::registry_shape{});
+
+		pugi::xml_document doc;
+		if (auto result = doc.load_buffer(registry.data(), registry.size(), pugi::parse_default | pugi::parse_trim_pcdata); !result)
+			throw std::runtime_error(result.description());
+
+		auto version = vgen::read_vulkan_header_version(doc);
+		auto commands = vgen::read_commands(doc);
+		auto features = vgen::read_features(doc);
+		auto extensions = vgen::read_extensions(doc);
+		auto plan = vgen::build_emission_plan(version, features, extensions, commands);
+
+		auto work_dir = fs::absolute(parsed_options["work-dir"].as<std::string>());
+		auto compiler = fmt::format("{0} {1}", parsed_options["cc"].as<std::string>(), parsed_options["cflags"].as<std::string>());
+		auto calls = std::max<std::size_t>(parsed_options["calls"].as<std::size_t>(), 1);
+		auto runs = std::max<std::size_t>(parsed_options["runs"].as<std::size_t>(), 1);
+
+		auto vulkan_include = work_dir / "include";
+
+		fmt::memory_buffer header;
+		vgen::write_stand_in_vulkan_header(header, version, features, extensions, commands);
+		write_file(vulkan_include / "vulkan" / "vulkan.h", to_string(header));
+
+		const auto &command = get_hot_command(plan);
+
+		fmt::memory_buffer driver;
+		write_driver(driver, command);
+
+		fmt::print("{0}: {1} calls per run, compiling with {2}, fastest of {3} runs\n\n", command.name, calls, compiler, runs);
+
+		std::vector<dispatch_result> results;
+		for (const auto &variant : get_dispatch_variants())
+			results.emplace_back(run_loader(variant, vgen::generate_loader(plan, variant.options), to_string(driver), work_dir / variant.name, compiler, vulkan_include, calls, runs));
+
+		fmt::memory_buffer table;
+		write_table(table, results);
+		fmt::print("{0}", to_string(table));
+
+		if (parsed_options.count("json"))
+		{
+			fmt::memory_buffer json;
+			write_json(json, compiler, command.name, results);
+			std::ofstream(parsed_options["json"].as<std::string>()) << to_string(json);
+		}
+	}
+	catch (std::exception &e)
+	{
+		fmt::print(stderr, "{0}\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,354 @@
+#include <synth.hpp>
+#include <vgen.hpp>
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+#if !defined(VGEN_BENCH_CC)
+#define VGEN_BENCH_CC "cc"
+#endif
+
+namespace
+{
+	struct startup_variant
+	{
+		std::string name;
+		vgen::generator_options options;
+	};
+
+	struct startup_result
+	{
+		std::string name;
+
+		// init and both load functions, times are the fastest of all iterations
+		double load_seconds = 0;
+		std::size_t load_lookups = 0;
+
+		// the first call of every used command after loading
+		double first_use_seconds = 0;
+		std::size_t first_use_lookups = 0;
+	};
+
+	std::vector<startup_variant> get_startup_variants()
+	{
+		return {
+			{.name = "unrolled", .options = {.variant = vgen::loader_variant::prototypes}},
+			{.name = "table", .options = {.variant = vgen::loader_variant::prototypes, .init = vgen::init_mode::table}},
+			{.name = "lazy", .options = {.variant = vgen::loader_variant::prototypes, .init = vgen::init_mode::lazy}},
+			{.name = "aliases", .options = {.variant = vgen::loader_variant::prototypes, .share_alias_slots = true}},
+		};
+	}
+
+	void write_file(const fs::path &path, std::string_view contents)
+	{
+		fs::create_directories(path.parent_path());
+		std::ofstream(path, std::ios::binary) << contents;
+	}
+
+	void run_command(const std::string &command)
+	{
+		if (auto status = std::system(command.c_str()); status != 0)
+			throw std::runtime_error(fmt::format("Command failed ({0}): {1}", status, command));
+	}
+
+	// the device commands an application calls, the first ones in plan order
+	std::vector<const vgen::command_data *> get_used_commands(const vgen::emission_plan &plan, std::size_t count)
+	{
+		std::vector<const vgen::command_data *> used;
+
+		for (const auto &block : plan.device_blocks)
+			for (const auto &section : block.sections)
+				for (auto command : section.commands)
+					if (used.size() < count && command->name != "vkGetDeviceProcAddr"sv)
+						used.push_back(command);
+
+		return used;
+	}
+
+	// a program standing in for an application and its driver: the driver hands out a stub for every name and counts the lookups,
+	// the application loads the commands and then calls each used one once with zeroed arguments
+	// the synthetic registry only passes scalars and pointers, so a 0 fits every argument and return value
+	void write_driver(fmt::memory_buffer &out, const std::vector<const vgen::command_data *> &used)
+	{
+		auto sorted = used;
+		std::sort(begin(sorted), end(sorted), [](auto a, auto b) { return a->name < b->name; });
+
+		fmt::format_to(std::back_inserter(out), R"(#define _POSIX_C_SOURCE 199309L
+#include <vulkan_loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static size_t lookups;
+static size_t calls;
+
+static void VKAPI_PTR stub(void)
+{{
+	++calls;
+}}
+)");
+
+		for (auto command : sorted)
+		{
+			auto return_type = std::string_view(command->prototype).substr(0, command->prototype.rfind(command->name));
+			fmt::format_to(std::back_inserter(out), "\nstatic {0}VKAPI_PTR stub_{1}({2})\n{{\n\t++calls;\n{3}}}\n", return_type, command->name, command->params.empty() ? "void"sv : command->params, command->returns_void ? "" : "\treturn 0;\n");
+		}
+
+		fmt::format_to(std::back_inserter(out), "\nstatic const struct named_stub\n{{\n\tconst char *name;\n\tPFN_vkVoidFunction stub;\n}} stubs[] = {{\n");
+		for (auto command : sorted)
+			fmt::format_to(std::back_inserter(out), "\t{{\"{0}\", (PFN_vkVoidFunction)stub_{0}}},\n", command->name);
+		fmt::format_to(std::back_inserter(out), "\t{{0, 0}},\n}};\n");
+
+		fmt::format_to(std::back_inserter(out), R"(
+static int compare_stub(const void *name, const void *entry)
+{{
+	return strcmp((const char *)name, ((const struct named_stub *)entry)->name);
+}}
+
+static PFN_vkVoidFunction VKAPI_PTR get_device_proc(VkDevice device, const char *name);
+
+static PFN_vkVoidFunction VKAPI_PTR get_instance_proc(VkInstance instance, const char *name)
+{{
+	const struct named_stub *found;
+
+	(void)instance;
+	++lookups;
+
+	if (strcmp(name, "vkGetInstanceProcAddr") == 0)
+		return (PFN_vkVoidFunction)get_instance_proc;
+	if (strcmp(name, "vkGetDeviceProcAddr") == 0)
+		return (PFN_vkVoidFunction)get_device_proc;
+
+	found = bsearch(name, stubs, sizeof(stubs) / sizeof(stubs[0]) - 1, sizeof(stubs[0]), compare_stub);
+	return found ? found->stub : stub;
+}}
+
+static PFN_vkVoidFunction VKAPI_PTR get_device_proc(VkDevice device, const char *name)
+{{
+	(void)device;
+	return get_instance_proc(0, name);
+}}
+
+static double seconds(void)
+{{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}}
+
+static void use_commands(void)
+{{
+)");
+
+		for (auto command : used)
+		{
+			auto arguments = command->param_names.empty() ? 0 : std::count(begin(command->param_names), end(command->param_names), ',') + 1;
+
+			fmt::format_to(std::back_inserter(out), "\t{0}(", command->name);
+			for (std::ptrdiff_t i = 0; i < arguments; ++i)
+				fmt::format_to(std::back_inserter(out), "{0}0", i == 0 ? "" : ", ");
+			fmt::format_to(std::back_inserter(out), ");\n");
+		}
+
+		fmt::format_to(std::back_inserter(out), R"(}}
+
+int main(int argc, char *argv[])
+{{
+	static char instance, device;
+	double best_load = 1e30, best_use = 1e30;
+	size_t load_lookups = 0, use_lookups = 0;
+	int i, iterations = argc > 1 ? atoi(argv[1]) : 1;
+
+	for (i = 0; i < iterations; ++i)
+	{{
+		double start, loaded, used;
+
+		lookups = 0;
+		start = seconds();
+		vgen_init_vulkan_loader(get_instance_proc);
+		vgen_load_instance_procs((VkInstance)&instance);
+		vgen_load_device_procs((VkDevice)&device);
+		loaded = seconds();
+		load_lookups = lookups;
+
+		use_commands();
+		used = seconds();
+		use_lookups = lookups - load_lookups;
+
+		best_load = loaded - start < best_load ? loaded - start : best_load;
+		best_use = used - loaded < best_use ? used - loaded : best_use;
+	}}
+
+	if (calls != (size_t)iterations * {0})
+		return 1;
+
+	printf("%.9f %zu %.9f %zu\n", best_load, load_lookups, best_use, use_lookups);
+	return 0;
+}}
+)",
+			used.size());
+	}
+
+	startup_result run_loader(const startup_variant &variant, const std::vector<vgen::generated_file> &files, std::string_view driver, const fs::path &dir, const std::string &compiler, const fs::path &vulkan_include, std::size_t iterations)
+	{
+		for (const auto &file : files)
+			write_file(dir / file.name, file.contents);
+
+		write_file(dir / "driver.c", driver);
+
+		std::string sources;
+		for (const auto &file : files)
+			if (fs::path(file.name).extension() == ".c")
+				sources += fmt::format(R"( "{0}")", (dir / file.name).string());
+
+		auto program = dir / "startup";
+		auto timings = dir / "startup.txt";
+		run_command(fmt::format(R"({0} -I"{1}" -I"{2}"{3} "{4}" -o "{5}")", compiler, vulkan_include.string(), dir.string(), sources, (dir / "driver.c").string(), program.string()));
+		run_command(fmt::format(R"("{0}" {1} > "{2}")", program.string(), iterations, timings.string()));
+
+		startup_result result{.name = variant.name};
+
+		auto file = std::fopen(timings.string().c_str(), "r");
+		if (!file)
+			throw std::runtime_error("Unable to read " + timings.string());
+
+		auto read = std::fscanf(file, "%lf %zu %lf %zu", &result.load_seconds, &result.load_lookups, &result.first_use_seconds, &result.first_use_lookups);
+		std::fclose(file);
+
+		if (read != 4)
+			throw std::runtime_error("Unexpected output in " + timings.string());
+
+		return result;
+	}
+
+	void write_table(fmt::memory_buffer &out, const std::vector<startup_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{0:<12} {1:>10} {2:>12} {3:>14} {4:>17}\n", "variant", "load ms", "load lookups", "first use ms", "first use lookups");
+
+		for (const auto &result : results)
+		{
+			fmt::format_to(std::back_inserter(out), "{0:<12} {1:>10.3f} {2:>12} {3:>14.3f} {4:>17}\n",
+				result.name,
+				result.load_seconds * 1000,
+				result.load_lookups,
+				result.first_use_seconds * 1000,
+				result.first_use_lookups);
+		}
+	}
+
+	void write_json(fmt::memory_buffer &out, const std::string &compiler, std::size_t used, const std::vector<startup_result> &results)
+	{
+		fmt::format_to(std::back_inserter(out), "{{\n\t\"compiler\": \"{0}\",\n\t\"used_commands\": {1},\n\t\"variants\": [\n", vgen::json_escape(compiler), used);
+
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const auto &result = results[i];
+			fmt::format_to(std::back_inserter(out),
+				"\t\t{{\"name\": \"{0}\", \"load_seconds\": {1}, \"load_lookups\": {2}, \"first_use_seconds\": {3}, \"first_use_lookups\": {4}}}{5}\n",
+				result.name,
+				result.load_seconds,
+				result.load_lookups,
+				result.first_use_seconds,
+				result.first_use_lookups,
+				i + 1 < results.size() ? "," : "");
+		}
+
+		fmt::format_to(std::back_inserter(out), "\t]\n}}\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		cxxopts::Options options("vgen-startup-bench", "Runs the prototype loader generated in each init mode against a stand-in driver and reports its startup cost");
+
+		// clang-format off
+		options.add_options()
+			("h,help", "Show this help")
+			("s,scale", "scale of the synthetic registry", cxxopts::value<std::size_t>()->default_value("1"))
+			("used", "device commands the stand-in application calls after loading", cxxopts::value<std::size_t>()->default_value("50"))
+			("cc", "C compiler", cxxopts::value<std::string>()->default_value(VGEN_BENCH_CC))
+			("cflags", "flags passed to every compile", cxxopts::value<std::string>()->default_value("-O2"))
+			("work-dir", "directory for the generated and compiled files", cxxopts::value<std::string>()->default_value("vgen-startup-bench"))
+			("n,iterations", "loads of each loader, the fastest counts", cxxopts::value<std::size_t>()->default_value("20"))
+			("json", "also write the results as JSON to this file", cxxopts::value<std::string>());
+		// clang-format on
+
+		auto parsed_options = options.parse(argc, argv);
+		if (parsed_options.count("help"))
+		{
+			fmt::print("{0}", options.help());
+			return 0;
+		}
+
+		// the stand-in driver passes zeroed arguments, which only fits the scalar parameters of the synthetic registry
+		fmt::memory_buffer registry;
+		vgen::write_synthetic_registry(registry, vgen::scale_registry_shape(vgen::registry_shape{}, parsed_options["scale"].as<std::size_t>()));
+
+		pugi::xml_document doc;
+		if (auto result = doc.load_buffer(registry.data(), registry.size(), pugi::parse_default | pugi::parse_trim_pcdata); !result)
+			throw std::runtime_error(result.description());
+
+		auto version = vgen::read_vulkan_header_version(doc);
+		auto commands = vgen::read_commands(doc);
+		auto features = vgen::read_features(doc);
+		auto extensions = vgen::read_extensions(doc);
+		auto plan = vgen::build_emission_plan(version, features, extensions, commands);
+
+		auto work_dir = fs::absolute(parsed_options["work-dir"].as<std::string>());
+		auto compiler = fmt::format("{0} {1}", parsed_options["cc"].as<std::string>(), parsed_options["cflags"].as<std::string>());
+		auto iterations = std::max<std::size_t>(parsed_options["iterations"].as<std::size_t>(), 1);
+
+		auto vulkan_include = work_dir / "include";
+
+		fmt::memory_buffer header;
+		vgen::write_stand_in_vulkan_header(header, version, features, extensions, commands);
+		write_file(vulkan_include / "vulkan" / "vulkan.h", to_string(header));
+
+		auto used = get_used_commands(plan, parsed_options["used"].as<std::size_t>());
+
+		fmt::memory_buffer driver;
+		write_driver(driver, used);
+
+		fmt::print("synthetic registry: {0} commands, {1} used, compiling with {2}, fastest of {3} iterations\n\n", commands.size(), used.size(), compiler, iterations);
+
+		std::vector<startup_result> results;
+		for (const auto &variant : get_startup_variants())
+			results.emplace_back(run_loader(variant, vgen::generate_loader(plan, variant.options), to_string(driver), work_dir / variant.name, compiler, vulkan_include, iterations));
+
+		fmt::memory_buffer table;
+		write_table(table, results);
+		fmt::print("{0}", to_string(table));
+
+		if (parsed_options.count("json"))
+		{
+			fmt::memory_buffer json;
+			write_json(json, compiler, used.size(), results);
+			std::ofstream(parsed_options["json"].as<std::string>()) << to_string(json);
+		}
+	}
+	catch (std::exception &e)
+	{
+		fmt::print(stderr, "{0}\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,74 @@
+#include "synth.hpp"
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <string>
+
+using namespace std::literals;
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		cxxopts::Options options("vgen-synth", "Writes synthetic Vulkan API Registries for scalability testing of vgen");
+		options.positional_help("[output file]");
+
+		// clang-format off
+		options.add_options()
+			("h,help", "Show this help")
+			("o,out", "registry file to write", cxxopts::value<std::string>()->default_value("vk-synth.xml"))
+			("s,scale", "multiply every count of the default vk.xml sized shape by this factor, e.g. 1, 10 or 100", cxxopts::value<std::size_t>()->default_value("1"))
+			("commands", "commands with a prototype, overrides the scaled count", cxxopts::value<std::size_t>())
+			("aliases", "alias commands, overrides the scaled count", cxxopts::value<std::size_t>())
+			("alias-depth", "longest chain of aliases of aliases, overrides the scaled depth", cxxopts::value<std::size_t>())
+			("features", "features, overrides the scaled count", cxxopts::value<std::size_t>())
+			("extensions", "extensions, overrides the scaled count", cxxopts::value<std::size_t>())
+			("shared-commands", "extension commands required by several extensions, overrides the scaled count", cxxopts::value<std::size_t>())
+			("requirement-groups", "most requirement groups one shared command lands in, overrides the scaled count", cxxopts::value<std::size_t>());
+		// clang-format on
+
+		options.parse_positional({"out"s});
+
+		auto parsed_options = options.parse(argc, argv);
+		if (parsed_options.count("help"))
+		{
+			fmt::print("{0}", options.help());
+			return 0;
+		}
+
+		auto shape = vgen::scale_registry_shape(vgen::registry_shape{}, parsed_options["scale"].as<std::size_t>());
+
+		// clang-format off
+		auto override_count = [&](const char *option, std::size_t &count)
+		{
+			if (parsed_options.count(option))
+				count = parsed_options[option].as<std::size_t>();
+		};
+		// clang-format on
+
+		override_count("commands", shape.commands);
+		override_count("aliases", shape.aliases);
+		override_count("alias-depth", shape.alias_depth);
+		override_count("features", shape.features);
+		override_count("extensions", shape.extensions);
+		override_count("shared-commands", shape.shared_commands);
+		override_count("requirement-groups", shape.requirement_groups);
+
+		fmt::memory_buffer registry;
+		vgen::write_synthetic_registry(registry, shape);
+
+		auto path = parsed_options["out"].as<std::string>();
+		std::ofstream(path, std::ios::binary) << to_string(registry);
+
+		fmt::print("Wrote {0}: {1} bytes, {2} commands, {3} aliases up to {4} deep, {5} features, {6} extensions\n", path, registry.size(), shape.commands, shape.aliases, shape.alias_depth, shape.features, shape.extensions);
+	}
+	catch (std::exception &e)
+	{
+		fmt::print(stderr, "{0}\n", e.what());
+		return 1;
+	}
+}
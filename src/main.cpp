@@ -7,6 +7,9 @@
 
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <new>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -14,6 +17,74 @@
 using namespace std::literals;
 namespace fs = std::filesystem;
 
+// count allocations for --timings
+void *operator new(std::size_t size)
+{
+	if (auto ptr = vgen::counted_allocate(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+std::string read_file(const fs::path &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Unable to read " + path.string());
+
+	return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// collects the commands referenced by the given files, directories are searched recursively
+std::set<std::string> find_used_commands(const std::vector<std::string> &paths, const vgen::command_map &commands)
+{
+	std::set<std::string> used;
+
+	auto scan = [&](const fs::path &path) {
+		auto referenced = vgen::find_referenced_commands(read_file(path), commands);
+		used.insert(begin(referenced), end(referenced));
+	};
+
+	for (const auto &path : paths)
+	{
+		if (fs::is_directory(path))
+		{
+			for (const auto &entry : fs::recursive_directory_iterator(path))
+				if (entry.is_regular_file())
+					scan(entry.path());
+		}
+		else
+			scan(path);
+	}
+
+	return used;
+}
+
 int main(int argc, char *argv[])
 {
 	constexpr auto major_style = fg(fmt::color::white) | fmt::emphasis::bold;
@@ -29,7 +100,31 @@ int main(int argc, char *argv[])
 		options.add_options()
 			("h,help", "Show this help")
 			("i,in", "path to Vulkan API Registry file (vk.xml)", cxxopts::value<std::string>())
-			("o,out", "output directory", cxxopts::value<std::string>());
+			("o,out", "output directory", cxxopts::value<std::string>())
+			("shards", "split the loader source across N translation units", cxxopts::value<std::size_t>()->default_value("1"))
+			("split-headers", "emit a lean core header plus one header per feature and extension")
+			("cpp-module", "also emit a C++20 module for the VK_NO_PROTOTYPES interface")
+			("variant", "loader interfaces to emit: both, prototypes, struct, or separate for one file set per interface", cxxopts::value<std::string>()->default_value("both"))
+			("init", "how the load functions fill in function pointers: unrolled, table for a loop over a packed command name table, or lazy to resolve each prototype on its first call", cxxopts::value<std::string>()->default_value("unrolled"))
+			("proc-lookup", "with --init table, also emit vgen_get_proc to look up loaded function pointers by name")
+			("availability", "with --init table, record which commands and which features and extension groups loaded in full, queried with vgen_has_command and vgen_has_group")
+			("device-dispatch", "with --init unrolled, keep the device level commands of every device loaded in the prototype variant and dispatch on the handle passed")
+			("inline-dispatch", "with --init unrolled or lazy, map the prototypes to their function pointers in the header so calls skip the wrapper")
+			("not-present-stubs", "with --init unrolled, point commands of the prototype variant that fail to load at a stub returning VK_ERROR_EXTENSION_NOT_PRESENT instead of asserting on every call")
+			("thread-safe", "with --init unrolled, keep the function pointers of the prototype variant in C11 atomics so concurrent calls of the load functions share one load")
+			("load-enabled-extensions", "with --init unrolled, also emit vgen_load_instance_procs_ex and vgen_load_device_procs_ex, which only load the commands of the api version and the extensions they are given")
+			("share-alias-slots", "with --init unrolled, look up the aliases of a command once, trying the promoted name first, and fill every alias with whichever name the driver has")
+			("async-device-load", "with --init unrolled, also emit vgen_load_device_procs_async, which loads the device commands of the prototype variant on a background thread, their wrappers wait for it when called before it is done")
+			("hot-commands", "with --async-device-load, comma separated device commands loaded before vgen_load_device_procs_async returns, e.g. vkCmdDraw", cxxopts::value<std::vector<std::string>>())
+			("api-version", "only emit features up to this Vulkan version, e.g. 1.2", cxxopts::value<std::string>())
+			("extensions", "comma separated glob patterns of extensions to emit, e.g. VK_KHR_*", cxxopts::value<std::vector<std::string>>())
+			("exclude-extensions", "comma separated glob patterns of extensions to leave out", cxxopts::value<std::vector<std::string>>())
+			("used-by", "comma separated source or object files and directories, only commands they reference are emitted, scan the sources of apps using the vgen_vulkan_api struct", cxxopts::value<std::vector<std::string>>())
+			("stats", "print the size each feature and extension group contributes to the loader")
+			("stats-json", "write the --stats report as JSON to this file", cxxopts::value<std::string>())
+			("timings", "print wall time, cpu time, allocations, and output size of each generator phase")
+			("timings-json", "write the --timings report as JSON to this file", cxxopts::value<std::string>())
+			("timings-trace", "write the --timings report as a Chrome trace (chrome://tracing, Perfetto) to this file", cxxopts::value<std::string>());
 		// clang-format on
 
 		options.parse_positional({"in"s, "out"s});
@@ -51,10 +146,80 @@ int main(int argc, char *argv[])
 		auto in_file = fs::path(parsed_options["in"].as<std::string>());
 		auto output_dir = parsed_options.count("out") ? fs::path(parsed_options["out"].as<std::string>()) : fs::current_path();
 
+		vgen::generator_options generator_options{
+			.shards = parsed_options["shards"].as<std::size_t>(),
+			.split_headers = parsed_options.count("split-headers") > 0,
+			.cpp_module = parsed_options.count("cpp-module") > 0,
+			.proc_lookup = parsed_options.count("proc-lookup") > 0,
+			.availability = parsed_options.count("availability") > 0,
+			.device_dispatch = parsed_options.count("device-dispatch") > 0,
+			.inline_dispatch = parsed_options.count("inline-dispatch") > 0,
+			.not_present_stubs = parsed_options.count("not-present-stubs") > 0,
+			.thread_safe = parsed_options.count("thread-safe") > 0,
+			.load_enabled_extensions = parsed_options.count("load-enabled-extensions") > 0,
+			.share_alias_slots = parsed_options.count("share-alias-slots") > 0,
+			.async_device_load = parsed_options.count("async-device-load") > 0,
+		};
+
+		if (parsed_options.count("hot-commands"))
+			generator_options.hot_commands = parsed_options["hot-commands"].as<std::vector<std::string>>();
+
+		if (generator_options.shards == 0)
+		{
+			fmt::print(stderr, error_style, "ERROR: --shards must be at least 1\n");
+			exit(1);
+		}
+
+		if (auto variant = parsed_options["variant"].as<std::string>(); variant == "prototypes")
+			generator_options.variant = vgen::loader_variant::prototypes;
+		else if (variant == "struct")
+			generator_options.variant = vgen::loader_variant::api_struct;
+		else if (variant == "separate")
+			generator_options.separate_variants = true;
+		else if (variant != "both")
+		{
+			fmt::print(stderr, error_style, "ERROR: unknown --variant '{0}'\n", variant);
+			exit(1);
+		}
+
+		if (auto init = parsed_options["init"].as<std::string>(); init == "table")
+			generator_options.init = vgen::init_mode::table;
+		else if (init == "lazy")
+			generator_options.init = vgen::init_mode::lazy;
+		else if (init != "unrolled")
+		{
+			fmt::print(stderr, error_style, "ERROR: unknown --init '{0}'\n", init);
+			exit(1);
+		}
+
+		vgen::registry_filter registry_filter;
+
+		if (parsed_options.count("api-version"))
+		{
+			auto api_version = parsed_options["api-version"].as<std::string>();
+			registry_filter.api_version = vgen::parse_version(api_version);
+			if (!registry_filter.api_version || *registry_filter.api_version < vgen::version_number{1, 0})
+			{
+				fmt::print(stderr, error_style, "ERROR: --api-version '{0}' is not a Vulkan version of the form major.minor\n", api_version);
+				exit(1);
+			}
+		}
+
+		if (parsed_options.count("extensions"))
+			registry_filter.extensions = parsed_options["extensions"].as<std::vector<std::string>>();
+
+		if (parsed_options.count("exclude-extensions"))
+			registry_filter.exclude_extensions = parsed_options["exclude-extensions"].as<std::vector<std::string>>();
+
+		pugi::set_memory_management_functions(vgen::counted_allocate, vgen::counted_deallocate);
+
+		vgen::phase_timings timings;
 		pugi::xml_document doc;
 
 		fmt::print(major_style, "Loading {0}\n", in_file.string());
+		vgen::begin_phase(timings, "load_document");
 		auto result = doc.load_file(in_file.c_str(), pugi::parse_default | pugi::parse_trim_pcdata);
+		vgen::end_phase(timings);
 		if (!result)
 		{
 			fmt::print(stderr, error_style, "{0}", result.description());
@@ -62,35 +227,118 @@ int main(int argc, char *argv[])
 		}
 
 		fmt::print(minor_style, "Reading header version.... ");
+		vgen::begin_phase(timings, "read_header_version");
 		auto version = vgen::read_vulkan_header_version(doc);
+		vgen::end_phase(timings);
 		fmt::print(minor_style, "{0}\n", version);
 
 		fmt::print(minor_style, "Reading commands\n");
+		vgen::begin_phase(timings, "read_commands");
 		auto commands = vgen::read_commands(doc);
+		vgen::end_phase(timings);
 
 		fmt::print(minor_style, "Reading features\n");
+		vgen::begin_phase(timings, "read_features");
 		auto features = vgen::read_features(doc);
+		vgen::end_phase(timings);
 
 		fmt::print(minor_style, "Reading extensions\n");
+		vgen::begin_phase(timings, "read_extensions");
 		auto extensions = vgen::read_extensions(doc);
+		vgen::end_phase(timings);
+
+		fmt::print(minor_style, "Filtering features and extensions\n");
+		vgen::begin_phase(timings, "filter_registry");
+		features = vgen::filter_features(features, registry_filter);
+		extensions = vgen::filter_extensions(extensions, registry_filter);
+		vgen::end_phase(timings);
+
+		if (parsed_options.count("used-by"))
+		{
+			fmt::print(minor_style, "Finding referenced commands\n");
+			vgen::begin_phase(timings, "find_used_commands");
+			auto used = find_used_commands(parsed_options["used-by"].as<std::vector<std::string>>(), commands);
+
+			auto keep = vgen::get_command_closure(used, commands);
+			features = vgen::filter_feature_commands(features, keep);
+			extensions = vgen::filter_extension_commands(extensions, keep);
+			vgen::end_phase(timings);
+			fmt::print(minor_style, "Found {0} referenced commands\n", used.size());
+		}
 
 		fmt::print(major_style, "Generating loader\n");
 
+		fmt::print(minor_style, "Building emission plan\n");
+		vgen::begin_phase(timings, "build_emission_plan");
+		auto plan = vgen::build_emission_plan(version, features, extensions, commands);
+		vgen::end_phase(timings);
+
+		if (parsed_options.count("stats") || parsed_options.count("stats-json"))
 		{
-			fmt::memory_buffer header;
-			write_header(header, features, extensions, commands);
-			auto header_path = output_dir / fs::path("vulkan_loader.h");
-			fmt::print(minor_style, "Writing {0}\n", header_path.string());
-			std::ofstream header_file(header_path);
-			header_file << to_string(header);
+			auto stats = vgen::get_emission_stats(plan);
+
+			if (parsed_options.count("stats"))
+			{
+				fmt::memory_buffer report;
+				vgen::write_stats_text(report, stats);
+				fmt::print("{0}", to_string(report));
+			}
+
+			if (parsed_options.count("stats-json"))
+			{
+				auto path = fs::path(parsed_options["stats-json"].as<std::string>());
+				fmt::print(minor_style, "Writing {0}\n", path.string());
+
+				fmt::memory_buffer report;
+				vgen::write_stats_json(report, stats);
+				std::ofstream(path) << to_string(report);
+			}
 		}
+
+		vgen::begin_phase(timings, "generate_loader");
+		auto files = vgen::generate_loader(plan, generator_options);
+
+		std::size_t output_bytes = 0;
+		for (const auto &file : files)
+			output_bytes += file.contents.size();
+		vgen::end_phase(timings, output_bytes);
+
+		vgen::begin_phase(timings, "write_files");
+		for (const auto &file : files)
 		{
-			fmt::memory_buffer source;
-			write_source(source, version, features, extensions, commands);
-			auto source_path = output_dir / fs::path("vulkan_loader.c");
-			fmt::print(minor_style, "Writing {0}\n", source_path.string());
-			std::ofstream source_file(source_path);
-			source_file << to_string(source);
+			auto path = output_dir / fs::path(file.name);
+			fmt::print(minor_style, "Writing {0}\n", path.string());
+			fs::create_directories(path.parent_path());
+			std::ofstream out_file(path);
+			out_file << file.contents;
+		}
+		vgen::end_phase(timings);
+
+		if (parsed_options.count("timings"))
+		{
+			fmt::memory_buffer report;
+			vgen::write_timings_text(report, timings);
+			fmt::print("{0}", to_string(report));
+		}
+
+		if (parsed_options.count("timings-json"))
+		{
+			auto path = fs::path(parsed_options["timings-json"].as<std::string>());
+			fmt::print(minor_style, "Writing {0}\n", path.string());
+
+			fmt::memory_buffer report;
+			vgen::write_timings_json(report, timings);
+			std::ofstream(path) << to_string(report);
+		}
+
+		if (parsed_options.count("timings-trace"))
+		{
+			auto path = fs::path(parsed_options["timings-trace"].as<std::string>());
+			fmt::print(minor_style, "Writing {0}\n", path.string());
+
+			fmt::memory_buffer report;
+			vgen::write_timings_trace(report, timings);
+			std::ofstream(path) << to_string(report);
 		}
 
 		fmt::print(major_style, "Done!\n");
@@ -2,9 +2,19 @@
 
 #include <fmt/chrono.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 #include <iterator>
+#include <limits>
 #include <stdexcept>
 #include <utility>
 
@@ -123,6 +133,7 @@ namespace vgen
 			const auto &existing_command = iter->second;
 			command_data cmd = existing_command;
 			cmd.name = alias;
+			cmd.alias_of = existing_command.alias_of.empty() ? existing_command.name : existing_command.alias_of;
 
 			auto pos = cmd.prototype.find(existing_command.name);
 			cmd.prototype.replace(pos, existing_command.name.size(), alias);
@@ -234,57 +245,218 @@ namespace vgen
 		write_comments,
 	};
 
+	enum class init_style
+	{
+		globals,
+		api_struct,
+		stubbed_globals, // globals falling back to the not present stub of their command
+		atomic_globals,  // globals stored with relaxed C11 atomics
+	};
+
+	// functions that are defined in the spec, but are initialized elsewhere by the loader
+	bool is_global_function(std::string_view command)
+	{
+		return std::find(begin(global_functions), end(global_functions), command) != end(global_functions);
+	}
+
+	// where function pointers live in vgen_vulkan_api, members are empty unless the api is split into per unit structs
+	struct struct_layout
+	{
+		// block condition -> member prefix, e.g. "VK_VERSION_1_0_api."
+		std::unordered_map<std::string, std::string> members;
+
+		// member prefix of the vkGet*ProcAddr pointers used for loading
+		std::string loader_member;
+	};
+
+	std::string_view member_prefix(const struct_layout &layout, const plan_block &block)
+	{
+		if (auto it = layout.members.find(block.condition); it != end(layout.members))
+			return it->second;
+
+		return ""sv;
+	}
+
+	void write_command_init(fmt::memory_buffer &out, std::string_view command, init_target target, init_style style, std::string_view member = ""sv, std::string_view loader_member = ""sv)
+	{
+		const auto get_proc = target == init_target::instance ? "vkGetInstanceProcAddr(instance"sv : "vkGetDeviceProcAddr(device"sv;
+
+		if (style == init_style::api_struct)
+			fmt::format_to(std::back_inserter(out), "\tvk->{2}{0} = (PFN_{0})vk->{3}{1}, \"{0}\");\n", command, get_proc, member, loader_member);
+		else if (style == init_style::stubbed_globals)
+			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})vgen_loaded_or({1}, \"{0}\"), (PFN_vkVoidFunction)vgen_missing_{0});\n", command, get_proc);
+		else if (style == init_style::atomic_globals)
+			fmt::format_to(std::back_inserter(out), "\tatomic_store_explicit(&pfn_{0}, (PFN_{0}){1}, \"{0}\"), memory_order_relaxed);\n", command, get_proc);
+		else
+			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0}){1}, \"{0}\");\n", command, get_proc);
+	}
+
 	// clang-format off
 	template <typename Fn>
-	requires std::is_invocable_v<Fn, const std::string &>
-	void write_feature_commands(fmt::memory_buffer &out, const feature_data &feature, Fn func, option_comments comments = option_comments::write_comments)
+	requires std::is_invocable_v<Fn, const command_data &>
+	void write_block_commands(fmt::memory_buffer &out, const plan_block &block, Fn func, option_comments comments = option_comments::write_comments)
 	// clang-format on
 	{
+		// extension groups are written compactly, without comments or section breaks
+		if (block.kind == block_kind::extension)
+		{
+			fmt::format_to(std::back_inserter(out), "#if {0}\n", block.condition);
+
+			for (const auto &section : block.sections)
+				for (const auto *command : section.commands)
+					func(*command);
+
+			fmt::format_to(std::back_inserter(out), "#endif // {0}\n", block.condition);
+			return;
+		}
+
 		fmt::format_to(std::back_inserter(out), "\n");
 		if (comments == option_comments::write_comments)
-			fmt::format_to(std::back_inserter(out), "{0}", feature.comment);
+			fmt::format_to(std::back_inserter(out), "{0}", block.comment);
 
-		write_guard_start(out, feature.name);
+		fmt::format_to(std::back_inserter(out), "#if {0}\n", block.condition);
 
-		for (const auto &section : feature.sections)
+		for (const auto &section : block.sections)
 		{
 			fmt::format_to(std::back_inserter(out), "\n");
 			if (comments == option_comments::write_comments)
 				fmt::format_to(std::back_inserter(out), "{0}", section.comment);
 
-			for (const auto &command : section.commands)
-				func(command);
+			for (const auto *command : section.commands)
+				func(*command);
 		}
 
-		fmt::format_to(std::back_inserter(out), "\n");
-		write_guard_end(out, feature.name);
+		fmt::format_to(std::back_inserter(out), "\n#endif // {0}\n", block.condition);
 	}
 
-	// clang-format off
-	template <typename Fn>
-	requires std::is_invocable_v<Fn, const std::string &>
-	void write_extension_commands(fmt::memory_buffer &out, const extension_map &extensions, Fn func)
-	// clang-format on
+	// loader functions are left out, vgen_init_vulkan_loader fills them in
+	std::vector<std::vector<const command_data *>> get_alias_families(const std::vector<plan_block> &blocks)
 	{
-		const std::set<std::string> *current = nullptr;
+		std::vector<std::vector<const command_data *>> families;
+		std::unordered_map<std::string_view, std::size_t> family_index;
 
-		for (const auto &[reqs, command] : extensions)
+		for (const auto &block : blocks)
 		{
-			// We started a new group, close the old group (if applicable) and start another
-			if (!current || *current != reqs)
+			for (const auto &section : block.sections)
 			{
-				if (current)
-					fmt::format_to(std::back_inserter(out), "#endif // {0}\n", fmt::join(*current, " || "));
+				for (const auto *command : section.commands)
+				{
+					if (is_global_function(command->name))
+						continue;
+
+					const std::string_view canonical = command->alias_of.empty() ? command->name : command->alias_of;
+					auto [it, inserted] = family_index.try_emplace(canonical, families.size());
+					if (inserted)
+						families.emplace_back();
+
+					auto &family = families[it->second];
+					if (std::find(begin(family), end(family), command) != end(family))
+						continue;
+
+					if (command->alias_of.empty())
+						family.insert(begin(family), command);
+					else
+						family.emplace_back(command);
+				}
+			}
+		}
+
+		erase_if(families, [](const auto &family) { return family.size() < 2; });
+
+		return families;
+	}
+
+	// slot of each alias in the local array the load function resolves the alias families into
+	using alias_slots = std::unordered_map<std::string_view, std::size_t>;
+
+	// resolves every alias family once at the top of a load function
+	// the lookups are guarded by the conditions of all the family members, their slots are filled in their own blocks
+	alias_slots write_alias_resolution(fmt::memory_buffer &out, const std::vector<plan_block> &blocks, init_target target, init_style style, const struct_layout &layout)
+	{
+		alias_slots slots;
+
+		std::unordered_map<const command_data *, std::string_view> conditions;
+		for (const auto &block : blocks)
+			for (const auto &section : block.sections)
+				for (const auto *command : section.commands)
+					conditions.emplace(command, block.condition);
 
-				current = &reqs;
-				fmt::format_to(std::back_inserter(out), "#if {0}\n", fmt::join(*current, " || "));
+		const auto families = get_alias_families(blocks);
+		if (families.empty())
+			return slots;
+
+		const auto first_proc = target == init_target::instance ? "vgen_first_instance_proc"sv : "vgen_first_device_proc"sv;
+		const auto get_proc = target == init_target::instance ? "vkGetInstanceProcAddr"sv : "vkGetDeviceProcAddr"sv;
+		const auto loader = style == init_style::api_struct ? fmt::format("vk->{0}{1}", layout.loader_member, get_proc) : std::string(get_proc);
+		const auto handle = target == init_target::instance ? "instance"sv : "device"sv;
+
+		fmt::format_to(std::back_inserter(out), "\tPFN_vkVoidFunction aliased[{0}];\n\t(void)aliased;\n", families.size());
+
+		for (std::size_t i = 0; i < families.size(); ++i)
+		{
+			std::set<std::string_view> guards;
+			std::vector<std::string> names;
+			for (const auto *command : families[i])
+			{
+				guards.emplace(conditions.at(command));
+				names.emplace_back(fmt::format("\"{0}\"", command->name));
+				slots.emplace(command->name, i);
 			}
 
-			func(command);
+			// a named array rather than a compound literal, which C++ does not have
+			fmt::format_to(std::back_inserter(out), "#if {0}\n\tstatic const char *const vgen_alias_names_{1}[] = {{{5}, 0}};\n\taliased[{1}] = {2}({3}, {4}, vgen_alias_names_{1});\n#endif\n",
+				fmt::join(guards, " || "), i, first_proc, loader, handle, fmt::join(names, ", "));
 		}
 
-		if (current)
-			fmt::format_to(std::back_inserter(out), "#endif // {0}\n", fmt::join(*current, " || "));
+		return slots;
+	}
+
+	void write_alias_command_init(fmt::memory_buffer &out, std::string_view command, std::size_t slot, init_style style, std::string_view member)
+	{
+		if (style == init_style::api_struct)
+			fmt::format_to(std::back_inserter(out), "\tvk->{2}{0} = (PFN_{0})aliased[{1}];\n", command, slot, member);
+		else if (style == init_style::stubbed_globals)
+			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})vgen_loaded_or(aliased[{1}], (PFN_vkVoidFunction)vgen_missing_{0});\n", command, slot);
+		else
+			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})aliased[{1}];\n", command, slot);
+	}
+
+	void write_block_loads(fmt::memory_buffer &out, const plan_block &block, init_target target, init_style style, const struct_layout &layout = {}, const alias_slots &aliases = {})
+	{
+		const auto member = member_prefix(layout, block);
+
+		// clang-format off
+		write_block_commands(out, block,
+			[&](const command_data &command)
+			{
+				// vgen_init_vulkan_loader loads the global functions, the device loads skip them too, as
+				// vkGetDeviceProcAddr returns NULL for them and would clear the pointers vgen_init_vulkan_loader set
+				if (is_global_function(command.name))
+					return;
+
+				if (auto slot = aliases.find(command.name); slot != end(aliases))
+					write_alias_command_init(out, command.name, slot->second, style, member);
+				else
+					write_command_init(out, command.name, target, style, member, layout.loader_member);
+			}, option_comments::no_comments
+		);
+		// clang-format on
+	}
+
+	void write_blocks_init(fmt::memory_buffer &out, const std::vector<plan_block> &blocks, init_target target, init_style style, const struct_layout &layout = {}, const alias_slots &aliases = {})
+	{
+		for (const auto &block : blocks)
+			write_block_loads(out, block, target, style, layout, aliases);
+	}
+
+	void write_block_init(fmt::memory_buffer &out, const plan_block &block, init_target target)
+	{
+		write_block_loads(out, block, target, init_style::globals);
+	}
+
+	void write_struct_block_init(fmt::memory_buffer &out, const plan_block &block, init_target target)
+	{
+		write_block_loads(out, block, target, init_style::api_struct);
 	}
 
 	std::string read_vulkan_header_version(const pugi::xml_document &doc)
@@ -303,35 +475,34 @@ namespace vgen
 		fmt::format_to(std::back_inserter(out), "#endif // defined({0})\n", guard);
 	}
 
-	void write_command_definition(fmt::memory_buffer &out, const command_data &command)
+	void write_command_definition(fmt::memory_buffer &out, const command_data &command, pfn_storage storage)
 	{
 		fmt::format_to(std::back_inserter(out),
 			R"(
-{5}static PFN_{0} pfn_{0};
+{5}{6}PFN_{0} pfn_{0};
 VKAPI_ATTR {1}({2})
 {{
-	assert(pfn_{0});
+	VKLG_ASSERT_MACRO(pfn_{0});
 	{4}pfn_{0}({3});
 }}
 )",
-			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", command.comment);
+			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", command.comment, storage == pfn_storage::file_scope ? "static " : "");
+	}
+
+	void write_block_definitions(fmt::memory_buffer &out, const plan_block &block, pfn_storage storage)
+	{
+		write_block_commands(out, block, [&](const command_data &command) { write_command_definition(out, command, storage); });
 	}
 
 	void write_feature_definitions(fmt::memory_buffer &out, const feature_data &feature, const command_map &commands)
 	{
-		// clang-format off
-		write_feature_commands(out, feature,
-			[&](const std::string &command)
-			{
-				write_command_definition(out, find_command(command, commands));
-			}
-		);
-		// clang-format on
+		write_block_definitions(out, make_feature_block(feature, commands));
 	}
 
 	void write_extension_definitions(fmt::memory_buffer &out, const extension_map &extensions, const command_map &commands)
 	{
-		write_extension_commands(out, extensions, [&](const std::string &command) { write_command_definition(out, find_command(command, commands)); });
+		for (const auto &block : make_extension_blocks(extensions, commands))
+			write_block_definitions(out, block);
 	}
 
 	void write_struct_command_field(fmt::memory_buffer &out, const command_data &command)
@@ -340,167 +511,429 @@ VKAPI_ATTR {1}({2})
 		fmt::format_to(std::back_inserter(out), "\t{1}{2}PFN_{0} {0};\n", command.name, command.comment, tab);
 	}
 
+	void write_struct_section_comment(fmt::memory_buffer &out, const std::string &comment)
+	{
+		const std::string_view tab = comment.empty() ? "" : "\t";
+		fmt::format_to(std::back_inserter(out), "\n{1}{0}\n", comment, tab);
+	}
+
 	void write_struct_section_fields(fmt::memory_buffer &out, const section_data &section, const command_map &commands)
 	{
-		const std::string_view tab = section.comment.empty() ? "" : "\t";
-		fmt::format_to(std::back_inserter(out), "\n{1}{0}\n", section.comment, tab);
+		write_struct_section_comment(out, section.comment);
 
 		for (const auto &command : section.commands)
 			write_struct_command_field(out, find_command(command, commands));
 	}
 
-	void write_struct_feature_fields(fmt::memory_buffer &out, const feature_data &feature, const command_map &commands)
+	void write_struct_block_fields(fmt::memory_buffer &out, const plan_block &block)
 	{
-		fmt::format_to(std::back_inserter(out), "\n{0}", feature.comment);
-		write_guard_start(out, feature.name);
+		if (block.kind == block_kind::extension)
+		{
+			write_block_commands(out, block, [&](const command_data &command) { write_struct_command_field(out, command); });
+			return;
+		}
 
-		for (const auto &section : feature.sections)
-			write_struct_section_fields(out, section, commands);
+		// feature fields keep their section comments, which the other writers present differently
+		fmt::format_to(std::back_inserter(out), "\n{0}#if {1}\n", block.comment, block.condition);
 
-		fmt::format_to(std::back_inserter(out), "\n");
-		write_guard_end(out, feature.name);
+		for (const auto &section : block.sections)
+		{
+			write_struct_section_comment(out, section.comment);
+
+			for (const auto *command : section.commands)
+				write_struct_command_field(out, *command);
+		}
+
+		fmt::format_to(std::back_inserter(out), "\n#endif // {0}\n", block.condition);
+	}
+
+	void write_struct_feature_fields(fmt::memory_buffer &out, const feature_data &feature, const command_map &commands)
+	{
+		write_struct_block_fields(out, make_feature_block(feature, commands));
 	}
 
 	void write_struct_extension_fields(fmt::memory_buffer &out, const extension_map &extensions, const command_map &commands)
 	{
-		write_extension_commands(out, extensions, [&](const std::string &command) { write_struct_command_field(out, find_command(command, commands)); });
+		for (const auto &block : make_extension_blocks(extensions, commands))
+			write_struct_block_fields(out, block);
 	}
 
-	void write_feature_instance_init(fmt::memory_buffer &out, const feature_data &feature)
+	bool glob_match(std::string_view pattern, std::string_view text)
 	{
-		// clang-format off
-		write_feature_commands(out, feature,
-			[&](const std::string &command)
+		// iterative matcher, backtracks to the most recent '*' on a mismatch
+		std::size_t p = 0, t = 0;
+		std::size_t star = std::string_view::npos, star_text = 0;
+
+		while (t < text.size())
+		{
+			if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t]))
 			{
-				// filter out functions that are defined in the spec, but are initialized elsewhere by the loader
-				if (std::find(begin(global_functions), end(global_functions), command) != end(global_functions))
-					return;
+				++p;
+				++t;
+			}
+			else if (p < pattern.size() && pattern[p] == '*')
+			{
+				star = p++;
+				star_text = t;
+			}
+			else if (star != std::string_view::npos)
+			{
+				p = star + 1;
+				t = ++star_text;
+			}
+			else
+				return false;
+		}
 
-				fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})vkGetInstanceProcAddr(instance, \"{0}\");\n", command);
-			}, option_comments::no_comments
-		);
-		// clang-format on
+		while (p < pattern.size() && pattern[p] == '*')
+			++p;
+
+		return p == pattern.size();
 	}
 
-	void write_feature_device_init(fmt::memory_buffer &out, const feature_data &feature)
+	std::optional<version_number> parse_version(std::string_view version)
 	{
-		// clang-format off
-		write_feature_commands(out, feature, [&](const std::string &command)
-		{
-			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})vkGetDeviceProcAddr(device, \"{0}\");\n", command);
-		}, option_comments::no_comments);
-		// clang-format on
+		version_number result;
+
+		auto dot = version.find('.');
+		if (dot == std::string_view::npos)
+			return std::nullopt;
+
+		auto parse = [](std::string_view number, unsigned &value) {
+			auto [end, error] = std::from_chars(number.data(), number.data() + number.size(), value);
+			return !number.empty() && error == std::errc{} && end == number.data() + number.size();
+		};
+
+		if (!parse(version.substr(0, dot), result.major) || !parse(version.substr(dot + 1), result.minor))
+			return std::nullopt;
+
+		return result;
 	}
 
-	void write_extensions_instance_init(fmt::memory_buffer &out, const extension_map &extensions)
+	std::optional<version_number> feature_version(std::string_view feature_name)
 	{
-		// clang-format off
-		write_extension_commands(out, extensions,
-			[&](const std::string &command)
-			{
-				fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})vkGetInstanceProcAddr(instance, \"{0}\");\n",  command);
-			}
-		);
-		// clang-format on
+		// feature names look like VK_VERSION_1_2
+		constexpr auto marker = "_VERSION_"sv;
+		auto pos = feature_name.find(marker);
+		if (pos == std::string_view::npos)
+			return std::nullopt;
+
+		auto version = std::string(feature_name.substr(pos + marker.size()));
+		std::replace(begin(version), end(version), '_', '.');
+
+		return parse_version(version);
 	}
 
-	void write_extensions_device_init(fmt::memory_buffer &out, const extension_map &extensions)
+	std::vector<feature_data> filter_features(const std::vector<feature_data> &features, const registry_filter &filter)
 	{
-		// clang-format off
-		write_extension_commands(out, extensions,
-			[&](const std::string &command)
-			{
-				fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})vkGetDeviceProcAddr(device, \"{0}\");\n",  command);
-			}
-		);
-		// clang-format on
+		auto filtered = features;
+
+		if (filter.api_version)
+		{
+			erase_if(filtered, [&](const auto &feature) {
+				auto version = feature_version(feature.name);
+				return version && *filter.api_version < *version;
+			});
+		}
+
+		return filtered;
 	}
 
-	void write_feature_instance_init_struct(fmt::memory_buffer &out, const feature_data &feature)
+	bool is_requirement_enabled(std::string_view requirement, const registry_filter &filter)
 	{
-		// clang-format off
-		write_feature_commands(out, feature,
-			[&](const std::string &command)
+		auto matches = [](const auto &patterns, std::string_view name) {
+			return std::any_of(begin(patterns), end(patterns), [&](const auto &pattern) { return glob_match(pattern, name); });
+		};
+
+		for (const auto &name : requirement_names(requirement))
+		{
+			if (auto version = feature_version(name))
 			{
-				// filter out functions that are defined in the spec, but are initialized elsewhere by the loader
-				if (std::find(begin(global_functions), end(global_functions), command) != end(global_functions))
-					return;
+				if (filter.api_version && *filter.api_version < *version)
+					return false;
+			}
+			else if ((!filter.extensions.empty() && !matches(filter.extensions, name)) || matches(filter.exclude_extensions, name))
+				return false;
+		}
 
-				fmt::format_to(std::back_inserter(out), "\tvk->{0} = (PFN_{0})vk->vkGetInstanceProcAddr(instance, \"{0}\");\n", command);
-			}, option_comments::no_comments
-		);
-		// clang-format on
+		return true;
 	}
 
-	void write_feature_device_init_struct(fmt::memory_buffer &out, const feature_data &feature)
+	extension_map filter_extensions(const extension_map &extensions, const registry_filter &filter)
 	{
-		// clang-format off
-		write_feature_commands(out, feature, [&](const std::string &command)
+		// each requirement of a command is an alternative, drop the ones that can no longer be met
+		// and regroup the command by what is left, or drop the command when nothing is
+		extension_map filtered;
+
+		for (const auto &[requirements, command] : extensions)
 		{
-			fmt::format_to(std::back_inserter(out), "\tvk->{0} = (PFN_{0})vk->vkGetDeviceProcAddr(device, \"{0}\");\n", command);
-		}, option_comments::no_comments);
-		// clang-format on
+			std::set<std::string> enabled;
+			std::copy_if(begin(requirements), end(requirements), std::inserter(enabled, end(enabled)), [&](const auto &requirement) { return is_requirement_enabled(requirement, filter); });
+
+			if (!enabled.empty())
+				filtered.emplace(std::move(enabled), command);
+		}
+
+		return filtered;
 	}
 
-	void write_extensions_instance_init_struct(fmt::memory_buffer &out, const extension_map &extensions)
+	std::set<std::string> find_referenced_commands(std::string_view text, const command_map &commands)
 	{
-		// clang-format off
-		write_extension_commands(out, extensions,
-			[&](const std::string &command)
+		std::set<std::string> referenced;
+
+		auto is_identifier = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+		auto is_digit = [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+
+		auto reference = [&](std::string_view name) {
+			// Windows import references are __imp_vkCmdDraw, Mach-O spells C symbols _vkCmdDraw
+			if (name.starts_with("__imp_"sv))
+				name.remove_prefix(6);
+			if (name.starts_with('_'))
+				name.remove_prefix(1);
+
+			if (name.starts_with("PFN_"sv))
+				name.remove_prefix(4);
+
+			if (!name.starts_with("vk"sv))
+				return;
+
+			if (auto command = commands.find(std::string(name)); command != end(commands))
+				referenced.emplace(command->first);
+		};
+
+		for (auto it = begin(text); it != end(text);)
+		{
+			auto first = std::find_if(it, end(text), is_identifier);
+			auto last = std::find_if_not(first, end(text), is_identifier);
+			it = last;
+
+			auto identifier = std::string_view(first, last);
+			reference(identifier);
+
+			// mangled C++ symbols embed names prefixed by their length, e.g. _Z4drawP13PFN_vkCmdDraw
+			for (std::size_t pos = 0; pos < identifier.size(); ++pos)
 			{
-				fmt::format_to(std::back_inserter(out), "\tvk->{0} = (PFN_{0})vk->vkGetInstanceProcAddr(instance, \"{0}\");\n", command);
+				if (!is_digit(identifier[pos]) || (pos > 0 && is_digit(identifier[pos - 1])))
+					continue;
+
+				std::size_t length = 0;
+				auto [digits_end, error] = std::from_chars(identifier.data() + pos, identifier.data() + identifier.size(), length);
+				auto start = static_cast<std::size_t>(digits_end - identifier.data());
+
+				if (error == std::errc{} && length <= identifier.size() - start)
+					reference(identifier.substr(start, length));
 			}
-		);
-		// clang-format on
+		}
+
+		return referenced;
 	}
 
-	void write_extensions_device_init_struct(fmt::memory_buffer &out, const extension_map &extensions)
+	std::set<std::string> get_command_closure(const std::set<std::string> &referenced, const command_map &commands)
 	{
-		// clang-format off
-		write_extension_commands(out, extensions,
-			[&](const std::string &command)
-			{
-				fmt::format_to(std::back_inserter(out), "\tvk->{0} = (PFN_{0})vk->vkGetDeviceProcAddr(device, \"{0}\");\n", command);
-			}
-		);
-		// clang-format on
+		auto canonical_name = [&](const std::string &name) -> const std::string & {
+			const auto &command = find_command(name, commands);
+			return command.alias_of.empty() ? command.name : command.alias_of;
+		};
+
+		// vgen_init_vulkan_loader and the load functions always use these
+		std::set<std::string> canonical{"vkGetInstanceProcAddr"s, "vkGetDeviceProcAddr"s};
+		for (auto global : global_functions)
+			canonical.emplace(global);
+
+		for (const auto &name : referenced)
+			canonical.emplace(canonical_name(name));
+
+		std::set<std::string> closure;
+		for (const auto &[name, command] : commands)
+			if (canonical.contains(command.alias_of.empty() ? name : command.alias_of))
+				closure.emplace(name);
+
+		return closure;
 	}
 
-	std::vector<feature_data> get_device_features(const std::vector<feature_data> &features, const command_map &commands)
+	std::vector<feature_data> filter_feature_commands(const std::vector<feature_data> &features, const std::set<std::string> &keep)
 	{
-		// just copy features and filter. Not the fastest or most memory effecient way, but good enough
-		auto device_features = features;
+		auto filtered = features;
 
-		for (auto &feature : device_features)
+		for (auto &feature : filtered)
 		{
 			for (auto &section : feature.sections)
-				erase_if(section.commands, [&](const auto &command) { return !commands.at(command).is_device_command; });
+				erase_if(section.commands, [&](const auto &command) { return !keep.contains(command); });
 
 			erase_if(feature.sections, [](const auto &section) { return section.commands.empty(); });
 		}
 
-		erase_if(device_features, [](const auto &feature) { return feature.sections.empty(); });
+		erase_if(filtered, [](const auto &feature) { return feature.sections.empty(); });
+
+		return filtered;
+	}
+
+	extension_map filter_extension_commands(const extension_map &extensions, const std::set<std::string> &keep)
+	{
+		auto filtered = extensions;
+		erase_if(filtered, [&](const auto &item) { return !keep.contains(item.second); });
+
+		return filtered;
+	}
+
+	plan_block make_feature_block(const feature_data &feature, const command_map &commands)
+	{
+		plan_block block{
+			.kind = block_kind::feature,
+			.name = feature.name,
+			.condition = fmt::format("defined({0})", feature.name),
+			.comment = feature.comment,
+		};
+		block.requirements.emplace(block.condition);
+
+		for (const auto &section : feature.sections)
+		{
+			plan_section plan{
+				.comment = section.comment,
+			};
+
+			for (const auto &command : section.commands)
+				plan.commands.emplace_back(&find_command(command, commands));
+
+			block.sections.emplace_back(std::move(plan));
+		}
+
+		return block;
+	}
+
+	std::vector<plan_block> make_extension_blocks(const extension_map &extensions, const command_map &commands)
+	{
+		std::vector<plan_block> blocks;
+
+		// commands with the exact same requirements are adjacent in the map and share a block
+		for (auto it = begin(extensions); it != end(extensions);)
+		{
+			auto condition = fmt::format("{0}", fmt::join(it->first, " || "));
+
+			plan_block block{
+				.kind = block_kind::extension,
+				.name = condition,
+				.condition = condition,
+				.requirements = it->first,
+			};
+
+			auto &section = block.sections.emplace_back();
+			for (auto last = extensions.upper_bound(it->first); it != last; ++it)
+				section.commands.emplace_back(&find_command(it->second, commands));
+
+			blocks.emplace_back(std::move(block));
+		}
+
+		return blocks;
+	}
+
+	std::vector<plan_block> get_device_blocks(const std::vector<plan_block> &blocks)
+	{
+		auto device_blocks = blocks;
+
+		for (auto &block : device_blocks)
+		{
+			for (auto &section : block.sections)
+				erase_if(section.commands, [](const auto *command) { return !command->is_device_command; });
+
+			erase_if(block.sections, [](const auto &section) { return section.commands.empty(); });
+		}
+
+		erase_if(device_blocks, [](const auto &block) { return block.sections.empty(); });
+
+		return device_blocks;
+	}
+
+	emission_plan build_emission_plan(std::string_view vulkan_header_version, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands)
+	{
+		emission_plan plan{
+			.vulkan_header_version = std::string(vulkan_header_version),
+		};
+
+		for (const auto &feature : features)
+			plan.blocks.emplace_back(make_feature_block(feature, commands));
+
+		auto extension_blocks = make_extension_blocks(extensions, commands);
+		plan.blocks.insert(end(plan.blocks), std::make_move_iterator(begin(extension_blocks)), std::make_move_iterator(end(extension_blocks)));
+
+		plan.device_blocks = get_device_blocks(plan.blocks);
+
+		return plan;
+	}
+
+	std::vector<std::string> requirement_names(std::string_view requirement)
+	{
+		std::vector<std::string> names;
+
+		constexpr auto prefix = "defined("sv;
+		for (auto pos = requirement.find(prefix); pos != std::string_view::npos; pos = requirement.find(prefix, pos))
+		{
+			pos += prefix.size();
+			auto last = requirement.find(')', pos);
+			if (last == std::string_view::npos)
+				throw std::runtime_error(fmt::format("malformed requirement: {0}", requirement));
+
+			names.emplace_back(requirement.substr(pos, last - pos));
+			pos = last;
+		}
 
-		return device_features;
+		return names;
 	}
 
-	extension_map get_device_extensions(const extension_map &extensions, const command_map &commands)
+	std::vector<header_unit> get_header_units(const emission_plan &plan)
 	{
-		// just copy and filter. Not the fastest or most memory effecient way, but good enough
-		auto device_extensions = extensions;
+		std::vector<header_unit> units;
+
+		// extension groups are filed under the first extension they require, sorted by name
+		std::map<std::string, header_unit> extension_units;
+
+		for (const auto &block : plan.blocks)
+		{
+			if (block.kind == block_kind::feature)
+			{
+				units.emplace_back(header_unit{.name = block.name, .guard = block.condition, .blocks = {&block}});
+				continue;
+			}
+
+			auto names = requirement_names(*begin(block.requirements));
+			if (names.empty())
+				throw std::runtime_error(fmt::format("extension group without requirements: {0}", block.condition));
+
+			auto &unit = extension_units[names.front()];
+			unit.name = names.front();
+			unit.blocks.emplace_back(&block);
+		}
 
-		for (auto it = cbegin(device_extensions); it != cend(device_extensions);)
+		for (auto &[name, unit] : extension_units)
 		{
-			if (!commands.at(it->second).is_device_command)
-				it = device_extensions.erase(it);
+			if (unit.blocks.size() == 1)
+				unit.guard = unit.blocks.front()->condition;
 			else
-				++it;
+			{
+				std::vector<std::string> conditions;
+				for (const auto *block : unit.blocks)
+					conditions.emplace_back(fmt::format("({0})", block->condition));
+
+				unit.guard = fmt::format("{0}", fmt::join(conditions, " || "));
+			}
+
+			units.emplace_back(std::move(unit));
 		}
 
-		return device_extensions;
+		return units;
+	}
+
+	std::string unit_header_name(const header_unit &unit)
+	{
+		return fmt::format("vulkan_loader_{0}.h", unit.name);
 	}
 
 	void write_header(fmt::memory_buffer &out, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands)
+	{
+		write_header(out, build_emission_plan(""sv, features, extensions, commands));
+	}
+
+	void write_header_preamble(fmt::memory_buffer &out)
 	{
 		auto now = [] {
 			using namespace std::chrono;
@@ -577,34 +1010,50 @@ extern "C" {{
 #endif
 )header",
 			now());
+	}
 
-		// structs for dynamic loading (always available / available by default)
-
-		// start of struct
-		fmt::format_to(std::back_inserter(out), R"(
-#if !defined(VK_NO_PROTOTYPES)
+	bool has_prototypes(loader_variant variant)
+	{
+		return variant != loader_variant::api_struct;
+	}
 
-void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address);
+	bool has_api_struct(loader_variant variant)
+	{
+		return variant != loader_variant::prototypes;
+	}
+
+	void write_header_prototype_declarations(fmt::memory_buffer &out)
+	{
+		fmt::format_to(std::back_inserter(out), R"(void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address);
 void vgen_load_instance_procs(VkInstance instance);
 void vgen_load_device_procs(VkDevice device);
+)");
+	}
 
-#else // !defined(VK_NO_PROTOTYPES)
-
-struct vgen_vulkan_api
-{{)");
-
-		for (const auto &feature : features)
-			write_struct_feature_fields(out, feature, commands);
-
-		write_struct_extension_fields(out, extensions, commands);
-
-		// end of struct
-		fmt::format_to(std::back_inserter(out), R"(}};
-
+	void write_header_struct_declarations(fmt::memory_buffer &out)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
 void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address, struct vgen_vulkan_api *vk);
 void vgen_load_instance_procs(VkInstance instance, struct vgen_vulkan_api *vk);
 void vgen_load_device_procs(VkDevice device, struct vgen_vulkan_api *vk);
+)");
+	}
+
+	// a variant left out of the generated loader is reported as soon as the header is included in that mode
+	void write_header_variants(fmt::memory_buffer &out, std::string_view prototype_declarations, std::string_view struct_declarations, loader_variant variant)
+	{
+		if (!has_prototypes(variant))
+			prototype_declarations = "#error vulkan_loader was generated for VK_NO_PROTOTYPES only. Define VK_NO_PROTOTYPES or regenerate the loader with the prototypes variant.\n"sv;
+
+		if (!has_api_struct(variant))
+			struct_declarations = "\n#error vulkan_loader was generated without the VK_NO_PROTOTYPES interface. Do not define VK_NO_PROTOTYPES or regenerate the loader with the struct variant.\n"sv;
+
+		fmt::format_to(std::back_inserter(out), R"(
+#if !defined(VK_NO_PROTOTYPES)
 
+{0}
+#else // !defined(VK_NO_PROTOTYPES)
+{1}
 #endif // !defined(VK_NO_PROTOTYPES)
 
 #if defined(__cplusplus)
@@ -612,19 +1061,192 @@ void vgen_load_device_procs(VkDevice device, struct vgen_vulkan_api *vk);
 #endif
 
 #endif // !defined(VGEN_VULKAN_LOADER_HEADER)
+)",
+			prototype_declarations, struct_declarations);
+	}
+
+	void write_has_declarations(fmt::memory_buffer &out, std::string_view params)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// whether the last load resolved the command, or every command of the group
+int vgen_has_command(enum vgen_command command{0});
+int vgen_has_group(enum vgen_group group{0});
+)",
+			params);
+	}
+
+	void write_async_load_declarations(fmt::memory_buffer &out)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// Like vgen_load_device_procs, but only the hot commands the loader was generated with are loaded before it returns,
+// a background thread loads the other device commands. Until it is done their wrappers wait for it, and
+// vgen_wait_device_procs waits for it too. The other load functions wait for it before loading. Don't call a command
+// of the previous device while loading another. On POSIX the loader needs to be linked with -pthread.
+void vgen_load_device_procs_async(VkDevice device);
+void vgen_wait_device_procs(void);
 )");
 	}
 
-	void write_source(fmt::memory_buffer &out, const std::string_view vulkan_header_version, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands)
+	void write_enabled_load_declarations(fmt::memory_buffer &out, std::string_view params)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// Like vgen_load_instance_procs and vgen_load_device_procs, but only the commands of the Vulkan versions up to
+// api_version and of the extensions given are loaded, the others are reset as if they failed to load.
+// api_version is the VkApplicationInfo::apiVersion the instance was created with, for a device the lower of that and
+// the apiVersion of its physical device. Give every extension the commands may come from, the device list needs the
+// instance extensions too, e.g. VK_KHR_surface for vkGetDeviceGroupSurfacePresentModesKHR of VK_KHR_device_group.
+void vgen_load_instance_procs_ex(VkInstance instance, uint32_t api_version, uint32_t extension_count, const char *const *extension_names{0});
+void vgen_load_device_procs_ex(VkDevice device, uint32_t api_version, uint32_t extension_count, const char *const *extension_names{0});
+)",
+			params);
+	}
+
+	void write_inline_dispatch(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// Calls go straight through the loaded function pointers, so the compiler emits a single indirect call at the
+// call site. Nothing checks the pointer before the call, and taking the address of a command gives the address
+// of its pointer. Define VGEN_NO_INLINE_DISPATCH to call the out of line wrappers instead.
+#if !defined(VGEN_NO_INLINE_DISPATCH)
+)");
+
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(out), "extern PFN_{0} pfn_{0};\n#define {0} pfn_{0}\n", command.name); }, option_comments::no_comments);
+
+		fmt::format_to(std::back_inserter(out), "\n#endif // !defined(VGEN_NO_INLINE_DISPATCH)\n");
+	}
+
+	void write_header(fmt::memory_buffer &out, const emission_plan &plan, loader_variant variant, const generator_options &options)
+	{
+		write_header_preamble(out);
+
+		// both variants index their dispatch table with the same enum
+		if (options.init == init_mode::table)
+			write_command_enum(out, plan);
+
+		if (options.availability)
+			write_group_enum(out, plan);
+
+		fmt::memory_buffer prototype_declarations;
+		if (has_prototypes(variant))
+		{
+			write_header_prototype_declarations(prototype_declarations);
+			if (options.proc_lookup)
+				fmt::format_to(std::back_inserter(prototype_declarations), "\n// the loaded function pointer of the named command, NULL if the loader has no such command\nPFN_vkVoidFunction vgen_get_proc(const char *name);\n");
+			if (options.availability)
+				write_has_declarations(prototype_declarations, ""sv);
+			if (options.device_dispatch)
+				fmt::format_to(std::back_inserter(prototype_declarations), "\n// forgets a device loaded by vgen_load_device_procs, call it before destroying the device\nvoid vgen_unload_device_procs(VkDevice device);\n");
+			if (options.load_enabled_extensions)
+				write_enabled_load_declarations(prototype_declarations, ""sv);
+			if (options.async_device_load)
+				write_async_load_declarations(prototype_declarations);
+			if (options.inline_dispatch)
+				write_inline_dispatch(prototype_declarations, plan);
+		}
+
+		fmt::memory_buffer struct_declarations;
+		if (has_api_struct(variant))
+		{
+			// structs for dynamic loading
+
+			// start of struct
+			fmt::format_to(std::back_inserter(struct_declarations), "\nstruct vgen_vulkan_api\n{{");
+
+			for (const auto &block : plan.blocks)
+				write_struct_block_fields(struct_declarations, block);
+
+			if (options.availability)
+				fmt::format_to(std::back_inserter(struct_declarations), "\n\tuint32_t available_commands[vgen_command_count / 32 + 1];\n\tuint32_t available_groups[vgen_group_count / 32 + 1];\n");
+
+			// end of struct
+			fmt::format_to(std::back_inserter(struct_declarations), "}};\n");
+
+			write_header_struct_declarations(struct_declarations);
+			if (options.proc_lookup)
+				fmt::format_to(std::back_inserter(struct_declarations), "\n// the loaded function pointer of the named command, NULL if the loader has no such command\nPFN_vkVoidFunction vgen_get_proc(const char *name, const struct vgen_vulkan_api *vk);\n");
+			if (options.availability)
+				write_has_declarations(struct_declarations, ", const struct vgen_vulkan_api *vk"sv);
+			if (options.load_enabled_extensions)
+				write_enabled_load_declarations(struct_declarations, ", struct vgen_vulkan_api *vk"sv);
+		}
+
+		write_header_variants(out, to_string(prototype_declarations), to_string(struct_declarations), variant);
+	}
+
+	void write_core_header(fmt::memory_buffer &out, const std::vector<header_unit> &units, loader_variant variant)
+	{
+		write_header_preamble(out);
+
+		fmt::memory_buffer prototype_declarations;
+		if (has_prototypes(variant))
+			write_header_prototype_declarations(prototype_declarations);
+
+		fmt::memory_buffer struct_declarations;
+		if (has_api_struct(variant))
+		{
+			fmt::format_to(std::back_inserter(struct_declarations), R"(
+// The function pointer table is opaque, allocate vgen_vulkan_api_size() bytes to hold it.
+// Include the header for each feature or extension you use to reach its function pointers:
+)");
+
+			for (const auto &unit : units)
+				fmt::format_to(std::back_inserter(struct_declarations), "//\t{0}\n", unit_header_name(unit));
+
+			fmt::format_to(std::back_inserter(struct_declarations), "struct vgen_vulkan_api;\n\nsize_t vgen_vulkan_api_size(void);\n");
+
+			write_header_struct_declarations(struct_declarations);
+		}
+
+		write_header_variants(out, to_string(prototype_declarations), to_string(struct_declarations), variant);
+	}
+
+	void write_unit_header(fmt::memory_buffer &out, const header_unit &unit)
 	{
-		const auto device_features = get_device_features(features, commands);
-		const auto device_extensions = get_device_extensions(extensions, commands);
+		fmt::format_to(std::back_inserter(out), R"(#if !defined(VGEN_VULKAN_LOADER_{0}_HEADER)
+#define VGEN_VULKAN_LOADER_{0}_HEADER
+
+#include <vulkan_loader.h>
+
+#if defined(VK_NO_PROTOTYPES) && ({1})
+
+#if defined(__cplusplus)
+extern "C" {{
+#endif
+
+struct vgen_{0}
+{{)",
+			unit.name, unit.guard);
+
+		// feature fields open with their comment on a new line, extension groups start with their guard
+		if (unit.blocks.front()->kind == block_kind::extension)
+			fmt::format_to(std::back_inserter(out), "\n");
+
+		for (const auto *block : unit.blocks)
+			write_struct_block_fields(out, *block);
+
+		fmt::format_to(std::back_inserter(out), R"(}};
+
+const struct vgen_{0} *vgen_get_{0}(const struct vgen_vulkan_api *vk);
+
+#if defined(__cplusplus)
+}} // extern "C"
+#endif
+
+#endif // defined(VK_NO_PROTOTYPES) && ({1})
 
+#endif // !defined(VGEN_VULKAN_LOADER_{0}_HEADER)
+)",
+			unit.name, unit.guard);
+	}
+
+	void write_source_preamble(fmt::memory_buffer &out, const std::string_view vulkan_header_version)
+	{
 		fmt::format_to(std::back_inserter(out), R"(#include <vulkan_loader.h>
 
 #if !defined(VKLG_ASSERT_MACRO)
 	#include <assert.h>
-	#define VKLG_ASSERT_MACRO assert;
+	#define VKLG_ASSERT_MACRO assert
 #endif
 
 #if VK_HEADER_VERSION > {0} && !defined(VK_NO_PROTOTYPES) && !defined(VGEN_VULKAN_LOADER_DISABLE_VERSION_CHECK)
@@ -633,80 +1255,2436 @@ void vgen_load_device_procs(VkDevice device, struct vgen_vulkan_api *vk);
 // define VK_NO_PROTOTYPES for a purely dynamic interface or disable this check by defining VGEN_VULKAN_LOADER_DISABLE_VERSION_CHECK.
 #error vulkan.h is newer than vulkan_loader. Define VK_NO_PROTOTYPES for the dynamic interface or disable this check via VGEN_VULKAN_LOADER_DISABLE_VERSION_CHECK.
 #endif
+)",
+			vulkan_header_version);
+	}
 
-#if defined(VK_NO_PROTOTYPES)
+	std::string_view load_function_params(init_style style)
+	{
+		return style == init_style::api_struct ? ", struct vgen_vulkan_api *vk"sv : ""sv;
+	}
 
-void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address, struct vgen_vulkan_api *vk)
-{{
-	vk->vkGetInstanceProcAddr = get_address;
-	vk->vkCreateInstance = (PFN_vkCreateInstance)vk->vkGetInstanceProcAddr(0, "vkCreateInstance");
-	vk->vkEnumerateInstanceExtensionProperties = (PFN_vkEnumerateInstanceExtensionProperties)vk->vkGetInstanceProcAddr(0, "vkEnumerateInstanceExtensionProperties");
-	vk->vkEnumerateInstanceLayerProperties = (PFN_vkEnumerateInstanceLayerProperties)vk->vkGetInstanceProcAddr(0, "vkEnumerateInstanceLayerProperties");
-}}
+	void write_unused_params(fmt::memory_buffer &out, std::string_view handle, init_style style)
+	{
+		fmt::format_to(std::back_inserter(out), "\t(void){0};\n", handle);
+		if (style == init_style::api_struct)
+			fmt::format_to(std::back_inserter(out), "\t(void)vk;\n");
+	}
+
+	bool has_instance_init(const std::vector<plan_block> &blocks)
+	{
+		for (const auto &block : blocks)
+			for (const auto &section : block.sections)
+				if (std::any_of(begin(section.commands), end(section.commands), [](const auto *command) { return !is_global_function(command->name); }))
+					return true;
 
-void vgen_load_instance_procs(VkInstance instance, struct vgen_vulkan_api *vk)
+		return false;
+	}
+
+	void write_load_functions(fmt::memory_buffer &out, const emission_plan &plan, init_style style, std::string_view suffix, const struct_layout &layout = {}, alias_loading aliases = alias_loading::separate)
+	{
+		fmt::format_to(std::back_inserter(out), R"(void vgen_load_instance_procs{0}(VkInstance instance{1})
 {{
 )",
-			vulkan_header_version);
+			suffix, load_function_params(style));
 
-		for (const auto &feature : features)
-			write_feature_instance_init_struct(out, feature);
+		alias_slots instance_slots;
+		if (aliases == alias_loading::shared)
+			instance_slots = write_alias_resolution(out, plan.blocks, init_target::instance, style, layout);
+
+		// a shard may not hold any commands of one kind
+		if (!has_instance_init(plan.blocks))
+			write_unused_params(out, "instance"sv, style);
 
-		write_extensions_instance_init_struct(out, extensions);
+		write_blocks_init(out, plan.blocks, init_target::instance, style, layout, instance_slots);
 
 		fmt::format_to(std::back_inserter(out), R"(}}
 
-void vgen_load_device_procs(VkDevice device, struct vgen_vulkan_api *vk)
+void vgen_load_device_procs{0}(VkDevice device{1})
 {{
-)");
+)",
+			suffix, load_function_params(style));
 
-		for (const auto &feature : device_features)
-			write_feature_device_init_struct(out, feature);
+		alias_slots device_slots;
+		if (aliases == alias_loading::shared)
+			device_slots = write_alias_resolution(out, plan.device_blocks, init_target::device, style, layout);
 
-		write_extensions_device_init_struct(out, device_extensions);
+		if (plan.device_blocks.empty())
+			write_unused_params(out, "device"sv, style);
 
-		fmt::format_to(std::back_inserter(out), R"(}}
+		write_blocks_init(out, plan.device_blocks, init_target::device, style, layout, device_slots);
 
-#else // defined(VK_NO_PROTOTYPES)
-)");
+		fmt::format_to(std::back_inserter(out), "}}\n");
+	}
 
-		for (const auto &feature : features)
-			write_feature_definitions(out, feature, commands);
+	// extension names are lower case past their vendor, so only feature names hold _VERSION_
+	bool is_feature_name(std::string_view name)
+	{
+		return name.find("_VERSION_"sv) != std::string_view::npos;
+	}
+
+	// the api version macro of a feature, e.g. VK_API_VERSION_1_2 for VK_VERSION_1_2
+	// empty for Vulkan 1.0, which every api version includes, and for names that aren't versions
+	std::string get_api_version_macro(std::string_view feature)
+	{
+		auto pos = feature.find("_VERSION_"sv);
+		if (pos == std::string_view::npos || feature.ends_with("_1_0"sv))
+			return {};
+
+		return fmt::format("{0}_API{1}", feature.substr(0, pos), feature.substr(pos));
+	}
+
+	// the runtime test of the api version and the enabled extensions matching the requirements of a block
+	// empty when an alternative only needs Vulkan 1.0, in which case the block is always loaded
+	std::string get_enabled_condition(const plan_block &block)
+	{
+		std::vector<std::string> alternatives;
+		for (const auto &requirement : block.requirements)
+		{
+			std::vector<std::string> terms;
+			for (const auto &name : requirement_names(requirement))
+			{
+				if (block.kind == block_kind::extension && !is_feature_name(name))
+					terms.emplace_back(fmt::format("vgen_extension_enabled(\"{0}\", extension_count, extension_names)", name));
+				else if (auto version = get_api_version_macro(name); !version.empty())
+					terms.emplace_back(fmt::format("api_version >= {0}", version));
+			}
+
+			if (terms.empty())
+				return {};
+
+			auto alternative = fmt::format("{0}", fmt::join(terms, " && "));
+			alternatives.emplace_back(terms.size() > 1 && block.requirements.size() > 1 ? fmt::format("({0})", alternative) : alternative);
+		}
+
+		return fmt::format("{0}", fmt::join(alternatives, " || "));
+	}
+
+	// the conditions an _ex load function tests, one per block it loads commands of
+	std::vector<std::string> get_enabled_conditions(const std::vector<plan_block> &blocks)
+	{
+		std::vector<std::string> conditions;
+
+		for (const auto &block : blocks)
+		{
+			auto loaded = false;
+			for (const auto &section : block.sections)
+				loaded = loaded || std::any_of(begin(section.commands), end(section.commands), [](const auto *command) { return !is_global_function(command->name); });
+
+			if (auto condition = get_enabled_condition(block); loaded && !condition.empty())
+				conditions.emplace_back(std::move(condition));
+		}
+
+		return conditions;
+	}
+
+	bool any_condition_uses(const std::vector<std::string> &conditions, std::string_view name)
+	{
+		return std::any_of(begin(conditions), end(conditions), [&](const auto &condition) { return condition.find(name) != std::string::npos; });
+	}
+
+	void write_enabled_command_init(fmt::memory_buffer &out, std::string_view command, init_target target, init_style style)
+	{
+		const auto get_proc = target == init_target::instance ? "vkGetInstanceProcAddr(instance"sv : "vkGetDeviceProcAddr(device"sv;
+
+		if (style == init_style::api_struct)
+			fmt::format_to(std::back_inserter(out), "\tvk->{0} = enabled ? (PFN_{0})vk->{1}, \"{0}\") : 0;\n", command, get_proc);
+		else if (style == init_style::stubbed_globals)
+			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = enabled ? (PFN_{0})vgen_loaded_or({1}, \"{0}\"), (PFN_vkVoidFunction)vgen_missing_{0}) : vgen_missing_{0};\n", command, get_proc);
+		else
+			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = enabled ? (PFN_{0}){1}, \"{0}\") : 0;\n", command, get_proc);
+	}
+
+	void write_enabled_blocks_init(fmt::memory_buffer &out, const std::vector<plan_block> &blocks, init_target target, init_style style)
+	{
+		for (const auto &block : blocks)
+		{
+			const auto condition = get_enabled_condition(block);
+			auto tested = false;
+
+			// clang-format off
+			write_block_commands(out, block,
+				[&](const command_data &command)
+				{
+					if (is_global_function(command.name))
+						return;
+
+					if (condition.empty())
+						write_command_init(out, command.name, target, style);
+					else
+					{
+						if (!tested)
+							fmt::format_to(std::back_inserter(out), "\tenabled = {0};\n", condition);
+
+						tested = true;
+						write_enabled_command_init(out, command.name, target, style);
+					}
+				}, option_comments::no_comments
+			);
+			// clang-format on
+		}
+	}
 
-		write_extension_definitions(out, extensions, commands);
+	void write_enabled_load_function(fmt::memory_buffer &out, const std::vector<plan_block> &blocks, init_target target, init_style style)
+	{
+		const auto handle = target == init_target::instance ? "instance"sv : "device"sv;
 
 		fmt::format_to(std::back_inserter(out), R"(
-void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address)
+void vgen_load_{0}_procs_ex({1} {0}, uint32_t api_version, uint32_t extension_count, const char *const *extension_names{2})
+{{
+)",
+			handle, target == init_target::instance ? "VkInstance"sv : "VkDevice"sv, load_function_params(style));
+
+		const auto conditions = get_enabled_conditions(blocks);
+		if (!conditions.empty())
+			fmt::format_to(std::back_inserter(out), "\tint enabled;\n");
+		if (!any_condition_uses(conditions, "api_version"sv))
+			fmt::format_to(std::back_inserter(out), "\t(void)api_version;\n");
+		if (!any_condition_uses(conditions, "vgen_extension_enabled"sv))
+			fmt::format_to(std::back_inserter(out), "\t(void)extension_count;\n\t(void)extension_names;\n");
+
+		if (target == init_target::instance ? !has_instance_init(blocks) : blocks.empty())
+			write_unused_params(out, handle, style);
+
+		write_enabled_blocks_init(out, blocks, target, style);
+
+		fmt::format_to(std::back_inserter(out), "}}\n");
+	}
+
+	// like the load functions, but blocks are only loaded when the api version and the enabled extensions satisfy them
+	void write_enabled_load_functions(fmt::memory_buffer &out, const emission_plan &plan, init_style style)
+	{
+		write_enabled_load_function(out, plan.blocks, init_target::instance, style);
+		write_enabled_load_function(out, plan.device_blocks, init_target::device, style);
+	}
+
+	void write_extension_enabled_function(fmt::memory_buffer &out)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+#include <string.h>
+
+// whether name is one of the extensions given to an _ex load function
+static int vgen_extension_enabled(const char *name, uint32_t extension_count, const char *const *extension_names)
+{{
+	uint32_t i;
+	for (i = 0; i < extension_count; ++i)
+		if (strcmp(extension_names[i], name) == 0)
+			return 1;
+
+	return 0;
+}}
+)");
+	}
+
+	void write_init_function(fmt::memory_buffer &out, init_style style, const struct_layout &layout = {})
+	{
+		if (style == init_style::api_struct)
+		{
+			fmt::format_to(std::back_inserter(out), R"(void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address, struct vgen_vulkan_api *vk)
+{{
+	vk->{0}vkGetInstanceProcAddr = get_address;
+	vk->{0}vkCreateInstance = (PFN_vkCreateInstance)vk->{0}vkGetInstanceProcAddr(0, "vkCreateInstance");
+	vk->{0}vkEnumerateInstanceExtensionProperties = (PFN_vkEnumerateInstanceExtensionProperties)vk->{0}vkGetInstanceProcAddr(0, "vkEnumerateInstanceExtensionProperties");
+	vk->{0}vkEnumerateInstanceLayerProperties = (PFN_vkEnumerateInstanceLayerProperties)vk->{0}vkGetInstanceProcAddr(0, "vkEnumerateInstanceLayerProperties");
+}}
+)",
+				layout.loader_member);
+		}
+		else if (style == init_style::stubbed_globals)
+		{
+			fmt::format_to(std::back_inserter(out), "void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address)\n{{\n\tpfn_vkGetInstanceProcAddr = get_address;\n");
+			for (const auto command : global_functions)
+				fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})vgen_loaded_or(vkGetInstanceProcAddr(0, \"{0}\"), (PFN_vkVoidFunction)vgen_missing_{0});\n", command);
+			fmt::format_to(std::back_inserter(out), "}}\n");
+		}
+		else
+		{
+			fmt::format_to(std::back_inserter(out), R"(void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address)
 {{
 	pfn_vkGetInstanceProcAddr = get_address;
 	pfn_vkCreateInstance = (PFN_vkCreateInstance)vkGetInstanceProcAddr(0, "vkCreateInstance");
 	pfn_vkEnumerateInstanceExtensionProperties = (PFN_vkEnumerateInstanceExtensionProperties)vkGetInstanceProcAddr(0, "vkEnumerateInstanceExtensionProperties");
 	pfn_vkEnumerateInstanceLayerProperties = (PFN_vkEnumerateInstanceLayerProperties)vkGetInstanceProcAddr(0, "vkEnumerateInstanceLayerProperties");
 }}
-
-void vgen_load_instance_procs(VkInstance instance)
-{{
 )");
+		}
+	}
 
-		for (const auto &feature : features)
-			write_feature_instance_init(out, feature);
+	// feature and extension names are defined as macros by vulkan.h, so they can't name a member directly
+	std::string unit_member_name(const header_unit &unit)
+	{
+		return fmt::format("{0}_api", unit.name);
+	}
 
-		write_extensions_instance_init(out, extensions);
+	struct_layout make_struct_layout(const std::vector<header_unit> &units)
+	{
+		struct_layout layout;
 
-		fmt::format_to(std::back_inserter(out), R"(}}
+		for (const auto &unit : units)
+		{
+			for (const auto *block : unit.blocks)
+			{
+				auto member = unit_member_name(unit) + ".";
+				for (const auto &section : block->sections)
+					if (std::any_of(begin(section.commands), end(section.commands), [](const auto *command) { return command->name == "vkGetInstanceProcAddr"sv; }))
+						layout.loader_member = member;
 
-void vgen_load_device_procs(VkDevice device)
+				layout.members.emplace(block->condition, std::move(member));
+			}
+		}
+
+		return layout;
+	}
+
+	void write_split_struct_definition(fmt::memory_buffer &out, const std::vector<header_unit> &units)
+	{
+		for (const auto &unit : units)
+			fmt::format_to(std::back_inserter(out), "#include <{0}>\n", unit_header_name(unit));
+
+		fmt::format_to(std::back_inserter(out), "\nstruct vgen_vulkan_api\n{{\n");
+
+		for (const auto &unit : units)
+			fmt::format_to(std::back_inserter(out), "#if {1}\n\tstruct vgen_{0} {2};\n#endif\n", unit.name, unit.guard, unit_member_name(unit));
+
+		fmt::format_to(std::back_inserter(out), "}};\n");
+	}
+
+	void write_split_struct_accessors(fmt::memory_buffer &out, const std::vector<header_unit> &units)
+	{
+		fmt::format_to(std::back_inserter(out), R"(size_t vgen_vulkan_api_size(void)
 {{
+	return sizeof(struct vgen_vulkan_api);
+}}
 )");
 
-		for (const auto &feature : device_features)
-			write_feature_device_init(out, feature);
+		for (const auto &unit : units)
+		{
+			fmt::format_to(std::back_inserter(out), R"(
+#if {1}
+const struct vgen_{0} *vgen_get_{0}(const struct vgen_vulkan_api *vk)
+{{
+	return &vk->{2};
+}}
+#endif
+)",
+				unit.name, unit.guard, unit_member_name(unit));
+		}
+	}
+
+	void write_source_struct_loader(fmt::memory_buffer &out, const emission_plan &plan, const std::vector<header_unit> &units, alias_loading aliases)
+	{
+		const auto layout = make_struct_layout(units);
+
+		if (!units.empty())
+		{
+			write_split_struct_definition(out, units);
+			fmt::format_to(std::back_inserter(out), "\n");
+			write_split_struct_accessors(out, units);
+			fmt::format_to(std::back_inserter(out), "\n");
+		}
+
+		write_init_function(out, init_style::api_struct, layout);
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_load_functions(out, plan, init_style::api_struct, ""sv, layout, aliases);
+	}
 
-		write_extensions_device_init(out, device_extensions);
+	void write_source_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, pfn_storage storage, alias_loading aliases)
+	{
+		for (const auto &block : plan.blocks)
+			write_block_definitions(out, block, storage);
 
-		fmt::format_to(std::back_inserter(out), R"(}}
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_init_function(out, init_style::globals);
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_load_functions(out, plan, init_style::globals, ""sv, {}, aliases);
+	}
+
+	void write_source_variants(fmt::memory_buffer &out, std::string_view struct_loader, std::string_view prototype_loader, loader_variant variant)
+	{
+		switch (variant)
+		{
+		case loader_variant::both:
+			fmt::format_to(std::back_inserter(out), R"(
+#if defined(VK_NO_PROTOTYPES)
 
+{0}
+#else // defined(VK_NO_PROTOTYPES)
+{1}
 #endif // defined(VK_NO_PROTOTYPES)
-)");
+)",
+				struct_loader, prototype_loader);
+			break;
+
+		case loader_variant::api_struct:
+			fmt::format_to(std::back_inserter(out), R"(
+#if defined(VK_NO_PROTOTYPES)
+
+{0}
+#endif // defined(VK_NO_PROTOTYPES)
+)",
+				struct_loader);
+			break;
+
+		case loader_variant::prototypes:
+			fmt::format_to(std::back_inserter(out), R"(
+#if !defined(VK_NO_PROTOTYPES)
+{0}
+#endif // !defined(VK_NO_PROTOTYPES)
+)",
+				prototype_loader);
+			break;
+		}
+	}
+
+	// the lazy loader resolves these eagerly, every trampoline resolves its command through them
+	bool is_loader_function(std::string_view command)
+	{
+		return command == "vkGetInstanceProcAddr"sv || command == "vkGetDeviceProcAddr"sv;
+	}
+
+	std::string_view lazy_resolver(const command_data &command)
+	{
+		if (is_global_function(command.name))
+			return "vgen_resolve_global_command"sv;
+
+		return command.is_device_command ? "vgen_resolve_device_command"sv : "vgen_resolve_instance_command"sv;
+	}
+
+	void write_lazy_command_definition(fmt::memory_buffer &out, const command_data &command, pfn_storage storage)
+	{
+		if (is_loader_function(command.name))
+		{
+			write_command_definition(out, command, storage);
+			return;
+		}
+
+		// the prototype is the return type followed by the name
+		const auto return_type = std::string_view(command.prototype).substr(0, command.prototype.size() - command.name.size());
+
+		// the pointer is never null, so the wrapper needs no check, a failed resolution asserts in the trampoline
+		fmt::format_to(std::back_inserter(out),
+			R"(
+{5}static VKAPI_ATTR {6}VKAPI_CALL vgen_lazy_{0}({2});
+{8}PFN_{0} pfn_{0} = vgen_lazy_{0};
+VKAPI_ATTR {1}({2})
+{{
+	{4}pfn_{0}({3});
+}}
+
+static VKAPI_ATTR {6}VKAPI_CALL vgen_lazy_{0}({2})
+{{
+	pfn_{0} = (PFN_{0}){7}("{0}");
+	VKLG_ASSERT_MACRO(pfn_{0});
+	{4}pfn_{0}({3});
+}}
+)",
+			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", command.comment, return_type, lazy_resolver(command), storage == pfn_storage::file_scope ? "static " : "");
+	}
+
+	// points the commands back at their trampolines, so the next call resolves them through the new instance or device
+	void write_lazy_resets(fmt::memory_buffer &out, const std::vector<plan_block> &blocks)
+	{
+		for (const auto &block : blocks)
+		{
+			// clang-format off
+			write_block_commands(out, block,
+				[&](const command_data &command)
+				{
+					if (!is_global_function(command.name) && !is_loader_function(command.name))
+						fmt::format_to(std::back_inserter(out), "\tpfn_{0} = vgen_lazy_{0};\n", command.name);
+				}, option_comments::no_comments
+			);
+			// clang-format on
+		}
+	}
+
+	void write_source_lazy_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, pfn_storage storage)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// the handles the trampolines resolve their commands with
+static VkInstance vgen_instance;
+static VkDevice vgen_device;
+
+static PFN_vkVoidFunction vgen_resolve_global_command(const char *name);
+static PFN_vkVoidFunction vgen_resolve_instance_command(const char *name);
+static PFN_vkVoidFunction vgen_resolve_device_command(const char *name);
+)");
+
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { write_lazy_command_definition(out, command, storage); });
+
+		fmt::format_to(std::back_inserter(out), R"(
+static PFN_vkVoidFunction vgen_resolve_global_command(const char *name)
+{{
+	return pfn_vkGetInstanceProcAddr(0, name);
+}}
+
+static PFN_vkVoidFunction vgen_resolve_instance_command(const char *name)
+{{
+	return pfn_vkGetInstanceProcAddr(vgen_instance, name);
+}}
+
+// device commands called before vgen_load_device_procs resolve through the instance, as the eager loader does
+static PFN_vkVoidFunction vgen_resolve_device_command(const char *name)
+{{
+	if (vgen_device)
+		return pfn_vkGetDeviceProcAddr(vgen_device, name);
+
+	return pfn_vkGetInstanceProcAddr(vgen_instance, name);
+}}
+
+void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address)
+{{
+	pfn_vkGetInstanceProcAddr = get_address;
+	vgen_instance = 0;
+	vgen_device = 0;
+)");
+
+		for (const auto command : global_functions)
+			fmt::format_to(std::back_inserter(out), "\tpfn_{0} = vgen_lazy_{0};\n", command);
+
+		fmt::format_to(std::back_inserter(out), R"(}}
+
+void vgen_load_instance_procs(VkInstance instance)
+{{
+	vgen_instance = instance;
+	vgen_device = 0;
+	pfn_vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)pfn_vkGetInstanceProcAddr(instance, "vkGetInstanceProcAddr");
+	pfn_vkGetDeviceProcAddr = (PFN_vkGetDeviceProcAddr)pfn_vkGetInstanceProcAddr(instance, "vkGetDeviceProcAddr");
+)");
+
+		write_lazy_resets(out, plan.blocks);
+
+		fmt::format_to(std::back_inserter(out), R"(}}
+
+void vgen_load_device_procs(VkDevice device)
+{{
+	vgen_device = device;
+	pfn_vkGetDeviceProcAddr = (PFN_vkGetDeviceProcAddr)pfn_vkGetDeviceProcAddr(device, "vkGetDeviceProcAddr");
+)");
+
+		write_lazy_resets(out, plan.device_blocks);
+
+		fmt::format_to(std::back_inserter(out), "}}\n");
+	}
+
+	void write_not_present_stub(fmt::memory_buffer &out, const command_data &command)
+	{
+		const auto return_type = std::string_view(command.prototype).substr(0, command.prototype.size() - command.name.size());
+
+		fmt::format_to(std::back_inserter(out), "static VKAPI_ATTR {0}VKAPI_CALL vgen_missing_{1}({2})\n{{\n", return_type, command.name, command.params.empty() ? "void"sv : command.params);
+
+		// parameter names are separated by ", "
+		const auto names = std::string_view(command.param_names);
+		for (std::size_t pos = 0; pos < names.size();)
+		{
+			auto last = std::min(names.find(',', pos), names.size());
+			fmt::format_to(std::back_inserter(out), "\t(void){0};\n", names.substr(pos, last - pos));
+			pos = last + 2;
+		}
+
+		// every other return type of the API is a number, a handle, or a function pointer
+		if (return_type == "VkResult "sv)
+			fmt::format_to(std::back_inserter(out), "\treturn VGEN_NOT_PRESENT_RESULT;\n");
+		else if (!command.returns_void)
+			fmt::format_to(std::back_inserter(out), "\treturn 0;\n");
+
+		fmt::format_to(std::back_inserter(out), "}}\n");
+	}
+
+	void write_stub_command_definition(fmt::memory_buffer &out, const command_data &command, pfn_storage storage)
+	{
+		fmt::format_to(std::back_inserter(out), "\n{0}", command.comment);
+		write_not_present_stub(out, command);
+
+		// the pointer is never null, so the wrapper needs no check
+		fmt::format_to(std::back_inserter(out),
+			R"({5}PFN_{0} pfn_{0} = vgen_missing_{0};
+VKAPI_ATTR {1}({2})
+{{
+	{4}pfn_{0}({3});
+}}
+)",
+			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", storage == pfn_storage::file_scope ? "static " : "");
+	}
+
+	void write_source_stub_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, pfn_storage storage, alias_loading aliases)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// commands that fail to load call a stub instead, which returns VGEN_NOT_PRESENT_RESULT if the command returns a VkResult
+#if !defined(VGEN_NOT_PRESENT_RESULT)
+	#define VGEN_NOT_PRESENT_RESULT VK_ERROR_EXTENSION_NOT_PRESENT
+#endif
+
+static PFN_vkVoidFunction vgen_loaded_or(PFN_vkVoidFunction loaded, PFN_vkVoidFunction missing)
+{{
+	return loaded ? loaded : missing;
+}}
+)");
+
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { write_stub_command_definition(out, command, storage); });
+
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_init_function(out, init_style::stubbed_globals);
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_load_functions(out, plan, init_style::stubbed_globals, ""sv, {}, aliases);
+	}
+
+	void write_atomic_command_definition(fmt::memory_buffer &out, const command_data &command)
+	{
+		fmt::format_to(std::back_inserter(out),
+			R"(
+{5}static _Atomic(PFN_{0}) pfn_{0};
+VKAPI_ATTR {1}({2})
+{{
+	PFN_{0} pfn = atomic_load_explicit(&pfn_{0}, memory_order_relaxed);
+	VKLG_ASSERT_MACRO(pfn);
+	{4}pfn({3});
+}}
+)",
+			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", command.comment);
+	}
+
+	// a load function calls its _locked body under the lock unless the handle it got was already loaded
+	// the release store of the handle publishes the relaxed stores of the body to callers taking the fast path
+	void write_once_guard(fmt::memory_buffer &out, std::string_view function, std::string_view params, std::string_view handle, std::string_view loaded)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+void {0}({1})
+{{
+	if (atomic_load_explicit(&{3}, memory_order_acquire) == {2})
+		return;
+
+	vgen_lock();
+	if (atomic_load_explicit(&{3}, memory_order_relaxed) != {2})
+	{{
+		{0}_locked({2});
+		atomic_store_explicit(&{3}, {2}, memory_order_release);
+	}}
+	vgen_unlock();
+}}
+)",
+			function, params, handle, loaded);
+	}
+
+	void write_source_atomic_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+#include <stdatomic.h>
+
+// what the load functions last loaded, reset by the load functions they depend on
+static _Atomic(PFN_vkGetInstanceProcAddr) vgen_loaded_get_address;
+static _Atomic(VkInstance) vgen_loaded_instance;
+static _Atomic(VkDevice) vgen_loaded_device;
+
+// loading takes well under a millisecond, so concurrent callers spin until the one loading is done
+static atomic_flag vgen_load_lock = ATOMIC_FLAG_INIT;
+
+static void vgen_lock(void)
+{{
+	while (atomic_flag_test_and_set_explicit(&vgen_load_lock, memory_order_acquire))
+	{{
+	}}
+}}
+
+static void vgen_unlock(void)
+{{
+	atomic_flag_clear_explicit(&vgen_load_lock, memory_order_release);
+}}
+)");
+
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { write_atomic_command_definition(out, command); });
+
+		fmt::format_to(std::back_inserter(out), R"(
+static void vgen_init_vulkan_loader_locked(PFN_vkGetInstanceProcAddr get_address)
+{{
+	atomic_store_explicit(&pfn_vkGetInstanceProcAddr, get_address, memory_order_relaxed);
+)");
+
+		for (const auto command : global_functions)
+			fmt::format_to(std::back_inserter(out), "\tatomic_store_explicit(&pfn_{0}, (PFN_{0})vkGetInstanceProcAddr(0, \"{0}\"), memory_order_relaxed);\n", command);
+
+		fmt::format_to(std::back_inserter(out), R"(	atomic_store_explicit(&vgen_loaded_instance, 0, memory_order_relaxed);
+	atomic_store_explicit(&vgen_loaded_device, 0, memory_order_relaxed);
+}}
+
+static void vgen_load_instance_procs_locked(VkInstance instance)
+{{
+	atomic_store_explicit(&vgen_loaded_device, 0, memory_order_relaxed);
+)");
+
+		write_blocks_init(out, plan.blocks, init_target::instance, init_style::atomic_globals);
+
+		fmt::format_to(std::back_inserter(out), R"(}}
+
+static void vgen_load_device_procs_locked(VkDevice device)
+{{
+)");
+
+		if (plan.device_blocks.empty())
+			write_unused_params(out, "device"sv, init_style::atomic_globals);
+
+		write_blocks_init(out, plan.device_blocks, init_target::device, init_style::atomic_globals);
+
+		fmt::format_to(std::back_inserter(out), "}}\n");
+
+		write_once_guard(out, "vgen_init_vulkan_loader"sv, "PFN_vkGetInstanceProcAddr get_address"sv, "get_address"sv, "vgen_loaded_get_address"sv);
+		write_once_guard(out, "vgen_load_instance_procs"sv, "VkInstance instance"sv, "instance"sv, "vgen_loaded_instance"sv);
+		write_once_guard(out, "vgen_load_device_procs"sv, "VkDevice device"sv, "device"sv, "vgen_loaded_device"sv);
+	}
+
+	// the device blocks holding only the commands keep says to, blocks left without commands are dropped
+	template <typename Fn>
+	std::vector<plan_block> filter_device_blocks(const emission_plan &plan, Fn keep)
+	{
+		auto blocks = plan.device_blocks;
+
+		for (auto &block : blocks)
+		{
+			for (auto &section : block.sections)
+				erase_if(section.commands, [&](const auto *command) { return !keep(*command); });
+
+			erase_if(block.sections, [](const auto &section) { return section.commands.empty(); });
+		}
+
+		erase_if(blocks, [](const auto &block) { return block.sections.empty(); });
+
+		return blocks;
+	}
+
+	// the background load looks up the other commands through vkGetDeviceProcAddr, so it is always hot
+	bool is_hot_command(const generator_options &options, std::string_view command)
+	{
+		return is_loader_function(command) || std::find(begin(options.hot_commands), end(options.hot_commands), command) != end(options.hot_commands);
+	}
+
+	// the commands the background load fills, vkGetDeviceProcAddr returns NULL for the global functions so the device loads skip them
+	bool is_deferred_command(const generator_options &options, const command_data &command)
+	{
+		return command.is_device_command && !is_global_function(command.name) && !is_hot_command(options, command.name);
+	}
+
+	void write_async_command_definition(fmt::memory_buffer &out, const command_data &command)
+	{
+		fmt::format_to(std::back_inserter(out),
+			R"(
+{5}static PFN_{0} pfn_{0};
+VKAPI_ATTR {1}({2})
+{{
+	if (atomic_load_explicit(&vgen_device_state, memory_order_acquire) == vgen_device_loading)
+		vgen_wait_device_procs();
+	VKLG_ASSERT_MACRO(pfn_{0});
+	{4}pfn_{0}({3});
+}}
+)",
+			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", command.comment);
+	}
+
+	void write_source_async_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+#include <stdatomic.h>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+// the background load publishes the device commands it wrote with the release store of vgen_device_loaded
+enum
+{{
+	vgen_device_idle,
+	vgen_device_loading,
+	vgen_device_loaded,
+}};
+
+static atomic_int vgen_device_state;
+
+void vgen_wait_device_procs(void)
+{{
+	while (atomic_load_explicit(&vgen_device_state, memory_order_acquire) == vgen_device_loading)
+	{{
+#if defined(_WIN32)
+		SwitchToThread();
+#else
+		sched_yield();
+#endif
+	}}
+}}
+)");
+
+		// clang-format off
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block,
+				[&](const command_data &command)
+				{
+					if (is_deferred_command(options, command))
+						write_async_command_definition(out, command);
+					else
+						write_command_definition(out, command, pfn_storage::file_scope);
+				}
+			);
+		// clang-format on
+
+		const auto hot_blocks = filter_device_blocks(plan, [&](const command_data &command) { return is_hot_command(options, command.name); });
+		const auto background_blocks = filter_device_blocks(plan, [&](const command_data &command) { return is_deferred_command(options, command); });
+
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_init_function(out, init_style::globals);
+
+		// loading the instance rewrites the device commands too, so it waits for a background load still writing them
+		fmt::format_to(std::back_inserter(out), "\nvoid vgen_load_instance_procs(VkInstance instance)\n{{\n\tvgen_wait_device_procs();\n");
+		if (!has_instance_init(plan.blocks))
+			write_unused_params(out, "instance"sv, init_style::globals);
+		write_blocks_init(out, plan.blocks, init_target::instance, init_style::globals);
+
+		fmt::format_to(std::back_inserter(out), "}}\n\nstatic void vgen_load_hot_device_procs(VkDevice device)\n{{\n");
+		if (hot_blocks.empty())
+			write_unused_params(out, "device"sv, init_style::globals);
+		write_blocks_init(out, hot_blocks, init_target::device, init_style::globals);
+
+		fmt::format_to(std::back_inserter(out), "}}\n\nstatic void vgen_load_background_device_procs(VkDevice device)\n{{\n");
+		if (background_blocks.empty())
+			write_unused_params(out, "device"sv, init_style::globals);
+		write_blocks_init(out, background_blocks, init_target::device, init_style::globals);
+
+		fmt::format_to(std::back_inserter(out), R"(}}
+
+void vgen_load_device_procs(VkDevice device)
+{{
+	vgen_wait_device_procs();
+	vgen_load_hot_device_procs(device);
+	vgen_load_background_device_procs(device);
+	atomic_store_explicit(&vgen_device_state, vgen_device_loaded, memory_order_release);
+}}
+
+#if defined(_WIN32)
+static DWORD WINAPI vgen_device_load_thread(LPVOID device)
+#else
+static void *vgen_device_load_thread(void *device)
+#endif
+{{
+	vgen_load_background_device_procs((VkDevice)device);
+	atomic_store_explicit(&vgen_device_state, vgen_device_loaded, memory_order_release);
+	return 0;
+}}
+
+void vgen_load_device_procs_async(VkDevice device)
+{{
+#if defined(_WIN32)
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+
+	vgen_wait_device_procs();
+	vgen_load_hot_device_procs(device);
+
+	// creating the thread orders this store before the one the thread makes when it is done
+	atomic_store_explicit(&vgen_device_state, vgen_device_loading, memory_order_relaxed);
+
+#if defined(_WIN32)
+	thread = CreateThread(0, 0, vgen_device_load_thread, (LPVOID)device, 0, 0);
+	if (thread)
+	{{
+		CloseHandle(thread);
+		return;
+	}}
+#else
+	if (pthread_create(&thread, 0, vgen_device_load_thread, (void *)device) == 0)
+	{{
+		pthread_detach(thread);
+		return;
+	}}
+#endif
+
+	// without a thread to spare the caller loads the rest itself
+	vgen_load_background_device_procs(device);
+	atomic_store_explicit(&vgen_device_state, vgen_device_loaded, memory_order_release);
+}}
+)");
+	}
+
+	// the global functions pass no handle first and other commands may pass a pointer, only device handles carry the key
+	bool takes_device_handle(const command_data &command)
+	{
+		const auto first = std::string_view(command.params).substr(0, command.params.find(','));
+		return first.starts_with("VkDevice "sv) || first.starts_with("VkQueue "sv) || first.starts_with("VkCommandBuffer "sv);
+	}
+
+	void write_device_table(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+#if !defined(VGEN_MAX_DEVICES)
+	#define VGEN_MAX_DEVICES 4
+#endif
+
+// the device level commands of one loaded device, keyed by the dispatch table pointer the loader and drivers
+// store first in every dispatchable handle, so a VkDevice shares its key with its queues and command buffers
+struct vgen_device_table
+{{
+	void *key;
+)");
+
+		for (const auto &block : filter_device_blocks(plan, takes_device_handle))
+			write_block_commands(out, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(out), "\tPFN_{0} {0};\n", command.name); }, option_comments::no_comments);
+
+		fmt::format_to(std::back_inserter(out), R"(}};
+
+static struct vgen_device_table vgen_devices[VGEN_MAX_DEVICES];
+static size_t vgen_device_count;
+
+// most applications load a single device, so the scan usually ends at the first entry
+static const struct vgen_device_table *vgen_find_device(const void *handle)
+{{
+	const void *key;
+	size_t i;
+
+	// destroy commands accept VK_NULL_HANDLE
+	if (!handle)
+		return 0;
+
+	key = *(const void *const *)handle;
+	for (i = 0; i < vgen_device_count; ++i)
+		if (vgen_devices[i].key == key)
+			return &vgen_devices[i];
+
+	return 0;
+}}
+)");
+	}
+
+	void write_device_dispatch_command_definition(fmt::memory_buffer &out, const command_data &command)
+	{
+		// device level commands take a VkDevice, VkQueue, or VkCommandBuffer first
+		const auto handle = std::string_view(command.param_names).substr(0, command.param_names.find(','));
+
+		// devices that were never loaded use the pointers loaded through the instance
+		fmt::format_to(std::back_inserter(out),
+			R"(
+{5}static PFN_{0} pfn_{0};
+VKAPI_ATTR {1}({2})
+{{
+	const struct vgen_device_table *device_table = vgen_find_device({6});
+	PFN_{0} pfn = device_table ? device_table->{0} : pfn_{0};
+	VKLG_ASSERT_MACRO(pfn);
+	{4}pfn({3});
+}}
+)",
+			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", command.comment, handle);
+	}
+
+	void write_source_device_dispatch_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		write_device_table(out, plan);
+
+		for (const auto &block : plan.blocks)
+		{
+			// clang-format off
+			write_block_commands(out, block,
+				[&](const command_data &command)
+				{
+					if (takes_device_handle(command))
+						write_device_dispatch_command_definition(out, command);
+					else
+						write_command_definition(out, command);
+				}
+			);
+			// clang-format on
+		}
+
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_init_function(out, init_style::globals);
+
+		fmt::format_to(std::back_inserter(out), R"(
+void vgen_load_instance_procs(VkInstance instance)
+{{
+)");
+
+		if (!has_instance_init(plan.blocks))
+			write_unused_params(out, "instance"sv, init_style::globals);
+
+		write_blocks_init(out, plan.blocks, init_target::instance, init_style::globals);
+
+		// a device loaded again keeps its entry, a device beyond VGEN_MAX_DEVICES uses the pointers loaded through the instance
+		fmt::format_to(std::back_inserter(out), R"(}}
+
+void vgen_load_device_procs(VkDevice device)
+{{
+	const void *key = *(const void *const *)device;
+	struct vgen_device_table *device_table = 0;
+	size_t i;
+
+	for (i = 0; i < vgen_device_count && !device_table; ++i)
+		if (vgen_devices[i].key == key)
+			device_table = &vgen_devices[i];
+
+	if (!device_table)
+	{{
+		if (vgen_device_count == VGEN_MAX_DEVICES)
+			return;
+
+		device_table = &vgen_devices[vgen_device_count++];
+		device_table->key = (void *)key;
+	}}
+)");
+
+		for (const auto &block : filter_device_blocks(plan, takes_device_handle))
+		{
+			// clang-format off
+			write_block_commands(out, block,
+				[&](const command_data &command)
+				{
+					fmt::format_to(std::back_inserter(out), "\tdevice_table->{0} = (PFN_{0})pfn_vkGetDeviceProcAddr(device, \"{0}\");\n", command.name);
+				}, option_comments::no_comments
+			);
+			// clang-format on
+		}
+
+		fmt::format_to(std::back_inserter(out), R"(}}
+
+void vgen_unload_device_procs(VkDevice device)
+{{
+	const void *key = *(const void *const *)device;
+	size_t i;
+
+	for (i = 0; i < vgen_device_count; ++i)
+	{{
+		if (vgen_devices[i].key == key)
+		{{
+			vgen_devices[i] = vgen_devices[--vgen_device_count];
+			return;
+		}}
+	}}
+}}
+)");
+	}
+
+	// the loader of each variant in the init mode of the options
+	void write_struct_loader(fmt::memory_buffer &out, const emission_plan &plan, const std::vector<header_unit> &units, const generator_options &options)
+	{
+		const auto aliases = options.share_alias_slots ? alias_loading::shared : alias_loading::separate;
+
+		if (options.init == init_mode::table)
+			write_source_table_struct_loader(out, plan, options);
+		else
+			write_source_struct_loader(out, plan, units, aliases);
+
+		if (options.load_enabled_extensions)
+			write_enabled_load_functions(out, plan, init_style::api_struct);
+	}
+
+	void write_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options)
+	{
+		// the header declares the pointers for inline dispatch
+		const auto storage = options.inline_dispatch ? pfn_storage::shared : pfn_storage::file_scope;
+		const auto aliases = options.share_alias_slots ? alias_loading::shared : alias_loading::separate;
+
+		switch (options.init)
+		{
+		case init_mode::unrolled:
+			if (options.device_dispatch)
+				write_source_device_dispatch_prototype_loader(out, plan);
+			else if (options.not_present_stubs)
+				write_source_stub_prototype_loader(out, plan, storage, aliases);
+			else if (options.thread_safe)
+				write_source_atomic_prototype_loader(out, plan);
+			else if (options.async_device_load)
+				write_source_async_prototype_loader(out, plan, options);
+			else
+				write_source_prototype_loader(out, plan, storage, aliases);
+			break;
+
+		case init_mode::table:
+			write_source_table_prototype_loader(out, plan, options);
+			break;
+
+		case init_mode::lazy:
+			write_source_lazy_prototype_loader(out, plan, storage);
+			break;
+		}
+
+		if (options.load_enabled_extensions)
+			write_enabled_load_functions(out, plan, options.not_present_stubs ? init_style::stubbed_globals : init_style::globals);
+	}
+
+	// the helpers the load functions resolve alias families with, only written when there are families to resolve
+	void write_first_proc_functions(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		if (!get_alias_families(plan.blocks).empty())
+		{
+			fmt::format_to(std::back_inserter(out), R"(
+// the first of the names the driver has a command for, so all the aliases of a command get whichever name it exposes
+static PFN_vkVoidFunction vgen_first_instance_proc(PFN_vkGetInstanceProcAddr get_proc, VkInstance instance, const char *const *names)
+{{
+	PFN_vkVoidFunction proc = 0;
+	for (; !proc && *names; ++names)
+		proc = get_proc(instance, *names);
+
+	return proc;
+}}
+)");
+		}
+
+		if (!get_alias_families(plan.device_blocks).empty())
+		{
+			fmt::format_to(std::back_inserter(out), R"(
+static PFN_vkVoidFunction vgen_first_device_proc(PFN_vkGetDeviceProcAddr get_proc, VkDevice device, const char *const *names)
+{{
+	PFN_vkVoidFunction proc = 0;
+	for (; !proc && *names; ++names)
+		proc = get_proc(device, *names);
+
+	return proc;
+}}
+)");
+		}
+	}
+
+	// the preamble and the tables both variants share, written before the variants
+	void write_source_start(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options)
+	{
+		// the source defines the wrappers under the names the header maps to the pointers
+		if (options.inline_dispatch)
+			fmt::format_to(std::back_inserter(out), "#if !defined(VGEN_NO_INLINE_DISPATCH)\n\t#define VGEN_NO_INLINE_DISPATCH\n#endif\n");
+
+		write_source_preamble(out, plan.vulkan_header_version);
+
+		if (options.init == init_mode::table)
+			write_command_name_table(out, plan);
+
+		if (options.availability)
+			write_group_table(out, plan);
+
+		if (options.proc_lookup)
+			write_proc_hash_table(out, plan);
+
+		if (options.share_alias_slots)
+			write_first_proc_functions(out, plan);
+
+		if (options.load_enabled_extensions && any_condition_uses(get_enabled_conditions(plan.blocks), "vgen_extension_enabled"sv))
+			write_extension_enabled_function(out);
+	}
+
+	void write_source(fmt::memory_buffer &out, const emission_plan &plan, const std::vector<header_unit> &units, loader_variant variant, const generator_options &options)
+	{
+		fmt::memory_buffer struct_loader;
+		if (has_api_struct(variant))
+			write_struct_loader(struct_loader, plan, units, options);
+
+		fmt::memory_buffer prototype_loader;
+		if (has_prototypes(variant))
+			write_prototype_loader(prototype_loader, plan, options);
+
+		write_source_start(out, plan, options);
+		write_source_variants(out, to_string(struct_loader), to_string(prototype_loader), variant);
+	}
+
+	std::size_t count_commands(const std::vector<plan_block> &blocks)
+	{
+		std::size_t count = 0;
+		for (const auto &block : blocks)
+			for (const auto &section : block.sections)
+				count += section.commands.size();
+
+		return count;
+	}
+
+	// the smallest C type able to hold values up to max
+	std::string_view index_type(std::size_t max)
+	{
+		return max <= std::numeric_limits<std::uint16_t>::max() ? "uint16_t"sv : "uint32_t"sv;
+	}
+
+	void write_command_enum(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// Slots of the dispatch table filled by the load functions. Commands whose guard is
+// not defined take no slot, so vgen_command_count is the size of the table.
+enum vgen_command
+{{
+)");
+
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(out), "\tvgen_command_{0},\n", command.name); }, option_comments::no_comments);
+
+		fmt::format_to(std::back_inserter(out), "\tvgen_command_count\n}};\n");
+	}
+
+	void write_command_name_table(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		std::size_t blob_size = 0;
+		for (const auto &block : plan.blocks)
+			for (const auto &section : block.sections)
+				for (const auto *command : section.commands)
+					blob_size += command->name.size() + 1;
+
+		// one char array per command lays the names out back to back, the compiler works out the offsets of those guarded in
+		fmt::format_to(std::back_inserter(out), "\nstatic const struct vgen_command_name_blob\n{{\n");
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(out), "\tchar {0}[sizeof(\"{0}\")];\n", command.name); }, option_comments::no_comments);
+
+		fmt::format_to(std::back_inserter(out), "}} vgen_command_names = {{\n");
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(out), "\t\"{0}\",\n", command.name); }, option_comments::no_comments);
+
+		fmt::format_to(std::back_inserter(out), "}};\n\nstatic const {0} vgen_command_offsets[vgen_command_count] = {{\n", index_type(blob_size));
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(out), "\toffsetof(struct vgen_command_name_blob, {0}),\n", command.name); }, option_comments::no_comments);
+
+		const auto command_type = index_type(count_commands(plan.blocks));
+
+		// the global functions are resolved by vgen_init_vulkan_loader
+		fmt::format_to(std::back_inserter(out), "}};\n\n// the slots vgen_load_instance_procs fills\nstatic const {0} vgen_instance_commands[] = {{\n", command_type);
+		for (const auto &block : plan.blocks)
+		{
+			// clang-format off
+			write_block_commands(out, block,
+				[&](const command_data &command)
+				{
+					if (!is_global_function(command.name))
+						fmt::format_to(std::back_inserter(out), "\tvgen_command_{0},\n", command.name);
+				}, option_comments::no_comments
+			);
+			// clang-format on
+		}
+
+		// vkGetDeviceProcAddr returns NULL for the global functions, which would clear them
+		fmt::format_to(std::back_inserter(out), "}};\n\n// the slots vgen_load_device_procs fills\nstatic const {0} vgen_device_commands[] = {{\n", command_type);
+		for (const auto &block : plan.device_blocks)
+		{
+			// clang-format off
+			write_block_commands(out, block,
+				[&](const command_data &command)
+				{
+					if (!is_global_function(command.name))
+						fmt::format_to(std::back_inserter(out), "\tvgen_command_{0},\n", command.name);
+				}, option_comments::no_comments
+			);
+			// clang-format on
+		}
+
+		fmt::format_to(std::back_inserter(out), R"(}};
+
+static const char *vgen_command_name(size_t command)
+{{
+	return (const char *)&vgen_command_names + vgen_command_offsets[command];
+}}
+)");
+	}
+
+	std::string get_group_name(const plan_block &block)
+	{
+		if (block.kind == block_kind::feature)
+			return block.name;
+
+		std::vector<std::string> alternatives;
+		for (const auto &requirement : block.requirements)
+			alternatives.emplace_back(fmt::format("{0}", fmt::join(requirement_names(requirement), "_and_")));
+
+		return fmt::format("{0}", fmt::join(alternatives, "_or_"));
+	}
+
+	// a block guard around every group, as around the commands, so vgen_group_count only counts the groups compiled in
+	template <typename Fn>
+	void write_group_entries(fmt::memory_buffer &out, const emission_plan &plan, Fn func)
+	{
+		for (const auto &block : plan.blocks)
+		{
+			fmt::format_to(std::back_inserter(out), "#if {0}\n", block.condition);
+			func(block);
+			fmt::format_to(std::back_inserter(out), "#endif // {0}\n", block.condition);
+		}
+	}
+
+	void write_group_enum(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		fmt::format_to(std::back_inserter(out), R"(
+// Requirement groups, a feature or the extension commands sharing the same requirements.
+// Groups whose guard is not defined take no id, like the commands.
+enum vgen_group
+{{
+)");
+
+		write_group_entries(out, plan, [&](const plan_block &block) { fmt::format_to(std::back_inserter(out), "\tvgen_group_{0},\n", get_group_name(block)); });
+
+		fmt::format_to(std::back_inserter(out), "\tvgen_group_count\n}};\n");
+	}
+
+	// the commands of a block are adjacent in the command enum, so a group is a range of the table
+	void write_group_table(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		const auto command_type = index_type(count_commands(plan.blocks));
+
+		fmt::format_to(std::back_inserter(out), "\nstatic const struct vgen_group_commands\n{{\n\t{0} first;\n\t{0} count;\n}} vgen_group_commands[vgen_group_count + 1] = {{\n", command_type);
+
+		// clang-format off
+		write_group_entries(out, plan,
+			[&](const plan_block &block)
+			{
+				for (const auto &section : block.sections)
+				{
+					if (!section.commands.empty())
+					{
+						fmt::format_to(std::back_inserter(out), "\t{{vgen_command_{0}, {1}}},\n", section.commands.front()->name, count_commands({block}));
+						return;
+					}
+				}
+
+				fmt::format_to(std::back_inserter(out), "\t{{0, 0}},\n");
+			}
+		);
+		// clang-format on
+
+		fmt::format_to(std::back_inserter(out), R"(	{{0, 0}},
+}};
+
+// a bit per group whose commands all resolved, rebuilt from the command bits after every load
+static void vgen_record_groups(const uint32_t *commands, uint32_t *groups)
+{{
+	size_t i, j;
+
+	for (i = 0; i < vgen_group_count / 32 + 1; ++i)
+		groups[i] = 0;
+	for (i = 0; i < vgen_group_count; ++i)
+	{{
+		size_t end = (size_t)vgen_group_commands[i].first + vgen_group_commands[i].count;
+		for (j = vgen_group_commands[i].first; j < end; ++j)
+			if (!((commands[j / 32] >> (j % 32)) & 1))
+				break;
+
+		if (j == end)
+			groups[i / 32] |= (uint32_t)1 << (i % 32);
+	}}
+}}
+)");
+	}
+
+	void write_has_functions(fmt::memory_buffer &out, init_style style)
+	{
+		const auto params = style == init_style::api_struct ? ", const struct vgen_vulkan_api *vk"sv : ""sv;
+		const auto bits = style == init_style::api_struct ? "vk->available_"sv : "vgen_available_"sv;
+
+		fmt::format_to(std::back_inserter(out), R"(
+int vgen_has_command(enum vgen_command command{0})
+{{
+	return (int)({1}commands[command / 32] >> (command % 32)) & 1;
+}}
+
+int vgen_has_group(enum vgen_group group{0})
+{{
+	return (int)({1}groups[group / 32] >> (group % 32)) & 1;
+}}
+)",
+			params, bits);
+	}
+
+	void write_table_command_definition(fmt::memory_buffer &out, const command_data &command)
+	{
+		fmt::format_to(std::back_inserter(out),
+			R"(
+{5}VKAPI_ATTR {1}({2})
+{{
+	PFN_{0} pfn = (PFN_{0})vgen_table[vgen_command_{0}];
+	VKLG_ASSERT_MACRO(pfn);
+	{4}pfn({3});
+}}
+)",
+			command.name, command.prototype, command.params, command.param_names, command.returns_void ? "" : "return ", command.comment);
+	}
+
+	// the struct has no table, its named fields are read and written through their offsets
+	void write_struct_field_offsets(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options)
+	{
+		// every field is a function pointer, assumed no larger than 8 bytes
+		fmt::format_to(std::back_inserter(out), R"(
+#include <stddef.h>
+#include <string.h>
+
+static const {0} vgen_command_fields[vgen_command_count] = {{
+)",
+			index_type(count_commands(plan.blocks) * 8));
+
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(out), "\toffsetof(struct vgen_vulkan_api, {0}),\n", command.name); }, option_comments::no_comments);
+
+		fmt::format_to(std::back_inserter(out), "}};\n");
+
+		// memcpy rather than a cast lvalue, as the fields are each of their own PFN type
+		if (options.proc_lookup || options.availability)
+			fmt::format_to(std::back_inserter(out), R"(
+static PFN_vkVoidFunction vgen_get_field(const struct vgen_vulkan_api *vk, size_t command)
+{{
+	PFN_vkVoidFunction pfn;
+	memcpy(&pfn, (const char *)vk + vgen_command_fields[command], sizeof(pfn));
+	return pfn;
+}}
+)");
+
+		fmt::format_to(std::back_inserter(out), R"(
+static void vgen_set_field(struct vgen_vulkan_api *vk, size_t command, PFN_vkVoidFunction pfn)
+{{
+	memcpy((char *)vk + vgen_command_fields[command], &pfn, sizeof(pfn));
+}}
+)");
+	}
+
+	// reads the loaded pointer of a command
+	std::string table_read(init_style style, std::string_view command)
+	{
+		if (style == init_style::api_struct)
+			return fmt::format("vgen_get_field(vk, {0})", command);
+
+		return fmt::format("vgen_table[{0}]", command);
+	}
+
+	// stores the loaded pointer of a command
+	std::string table_write(init_style style, std::string_view command, std::string_view pfn)
+	{
+		if (style == init_style::api_struct)
+			return fmt::format("vgen_set_field(vk, {0}, {1})", command, pfn);
+
+		return fmt::format("vgen_table[{0}] = {1}", command, pfn);
+	}
+
+	// a bit per command that resolved, rebuilt from the loaded pointers after every load
+	void write_record_availability_function(fmt::memory_buffer &out, init_style style)
+	{
+		const auto params = style == init_style::api_struct ? "struct vgen_vulkan_api *vk"sv : "void"sv;
+		const auto bits = style == init_style::api_struct ? "vk->available_"sv : "vgen_available_"sv;
+
+		fmt::format_to(std::back_inserter(out), R"(
+static void vgen_record_availability({0})
+{{
+	size_t i;
+
+	for (i = 0; i < vgen_command_count / 32 + 1; ++i)
+		{1}commands[i] = 0;
+	for (i = 0; i < vgen_command_count; ++i)
+		if ({2})
+			{1}commands[i / 32] |= (uint32_t)1 << (i % 32);
+
+	vgen_record_groups({1}commands, {1}groups);
+}}
+)",
+			params, bits, table_read(style, "i"));
+	}
+
+	// the call rebuilding the availability bitsets after a load, empty without them
+	std::string availability_record(init_style style, const generator_options &options)
+	{
+		if (!options.availability)
+			return {};
+
+		if (style == init_style::api_struct)
+			return "\tvgen_record_availability(vk);\n";
+
+		return "\tvgen_record_availability();\n";
+	}
+
+	void write_table_init_function(fmt::memory_buffer &out, init_style style, std::string_view record)
+	{
+		fmt::format_to(std::back_inserter(out), "void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address{0})\n{{\n", load_function_params(style));
+
+		if (style == init_style::api_struct)
+			fmt::format_to(std::back_inserter(out), "\tvk->vkGetInstanceProcAddr = get_address;\n");
+		else
+			fmt::format_to(std::back_inserter(out), "\tvgen_table[vgen_command_vkGetInstanceProcAddr] = (PFN_vkVoidFunction)get_address;\n");
+
+		for (const auto command : global_functions)
+		{
+			if (style == init_style::api_struct)
+				fmt::format_to(std::back_inserter(out), "\tvk->{0} = (PFN_{0})get_address(0, vgen_command_name(vgen_command_{0}));\n", command);
+			else
+				fmt::format_to(std::back_inserter(out), "\tvgen_table[vgen_command_{0}] = get_address(0, vgen_command_name(vgen_command_{0}));\n", command);
+		}
+
+		fmt::format_to(std::back_inserter(out), "{0}}}\n", record);
+	}
+
+	void write_table_load_functions(fmt::memory_buffer &out, init_style style, std::string_view record)
+	{
+		// the loader functions are read once up front rather than through the table on every iteration
+		const auto get_instance_proc = style == init_style::api_struct ? "vk->vkGetInstanceProcAddr"sv : "(PFN_vkGetInstanceProcAddr)vgen_table[vgen_command_vkGetInstanceProcAddr]"sv;
+		const auto get_device_proc = style == init_style::api_struct ? "vk->vkGetDeviceProcAddr"sv : "(PFN_vkGetDeviceProcAddr)vgen_table[vgen_command_vkGetDeviceProcAddr]"sv;
+
+		fmt::format_to(std::back_inserter(out), R"(void vgen_load_instance_procs(VkInstance instance{0})
+{{
+	PFN_vkGetInstanceProcAddr get_proc = {1};
+	for (size_t i = 0; i < sizeof(vgen_instance_commands) / sizeof(vgen_instance_commands[0]); ++i)
+		{3};
+{5}}}
+
+void vgen_load_device_procs(VkDevice device{0})
+{{
+	PFN_vkGetDeviceProcAddr get_proc = {2};
+	for (size_t i = 0; i < sizeof(vgen_device_commands) / sizeof(vgen_device_commands[0]); ++i)
+		{4};
+{5}}}
+)",
+			load_function_params(style), get_instance_proc, get_device_proc,
+			table_write(style, "vgen_instance_commands[i]", "get_proc(instance, vgen_command_name(vgen_instance_commands[i]))"),
+			table_write(style, "vgen_device_commands[i]", "get_proc(device, vgen_command_name(vgen_device_commands[i]))"), record);
+	}
+
+	void write_get_proc_function(fmt::memory_buffer &out, init_style style)
+	{
+		const auto params = style == init_style::api_struct ? ", const struct vgen_vulkan_api *vk"sv : ""sv;
+
+		fmt::format_to(std::back_inserter(out), R"(
+PFN_vkVoidFunction vgen_get_proc(const char *name{0})
+{{
+	size_t command = vgen_find_command(name);
+	return command != vgen_command_count ? {1} : 0;
+}}
+)",
+			params, table_read(style, "command"));
+	}
+
+	void write_source_table_struct_loader(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options)
+	{
+		write_struct_field_offsets(out, plan, options);
+
+		if (options.availability)
+			write_record_availability_function(out, init_style::api_struct);
+
+		const auto record = availability_record(init_style::api_struct, options);
+
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_table_init_function(out, init_style::api_struct, record);
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_table_load_functions(out, init_style::api_struct, record);
+
+		if (options.proc_lookup)
+			write_get_proc_function(out, init_style::api_struct);
+
+		if (options.availability)
+			write_has_functions(out, init_style::api_struct);
+	}
+
+	void write_source_table_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options)
+	{
+		fmt::format_to(std::back_inserter(out), "\nstatic PFN_vkVoidFunction vgen_table[vgen_command_count];\n");
+
+		if (options.availability)
+			fmt::format_to(std::back_inserter(out), "static uint32_t vgen_available_commands[vgen_command_count / 32 + 1];\nstatic uint32_t vgen_available_groups[vgen_group_count / 32 + 1];\n");
+
+		for (const auto &block : plan.blocks)
+			write_block_commands(out, block, [&](const command_data &command) { write_table_command_definition(out, command); });
+
+		if (options.availability)
+			write_record_availability_function(out, init_style::globals);
+
+		const auto record = availability_record(init_style::globals, options);
+
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_table_init_function(out, init_style::globals, record);
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_table_load_functions(out, init_style::globals, record);
+
+		if (options.proc_lookup)
+			write_get_proc_function(out, init_style::globals);
+
+		if (options.availability)
+			write_has_functions(out, init_style::globals);
+	}
+
+	std::uint32_t hash_name(std::string_view name, std::uint32_t seed)
+	{
+		std::uint32_t hash = 2166136261u ^ (seed * 2654435769u);
+		for (auto c : name)
+			hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+
+		hash ^= hash >> 16;
+		hash *= 2246822507u;
+		hash ^= hash >> 13;
+		hash *= 3266489909u;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	// hash and displace: buckets are placed largest first, each trying seeds until all of its names land on free positions
+	perfect_hash build_perfect_hash(const std::vector<std::string_view> &names)
+	{
+		// no seed separates a name from itself
+		auto sorted = names;
+		std::sort(begin(sorted), end(sorted));
+		if (auto duplicate = std::adjacent_find(begin(sorted), end(sorted)); duplicate != end(sorted))
+			throw std::runtime_error(fmt::format("Unable to build a perfect hash of the command names, '{0}' is listed twice", *duplicate));
+
+		const auto positions = std::max<std::size_t>(names.size(), 1);
+		const auto bucket_count = std::max<std::size_t>((names.size() + 3) / 4, 1);
+
+		std::vector<std::vector<std::size_t>> buckets(bucket_count);
+		for (std::size_t i = 0; i < names.size(); ++i)
+			buckets[hash_name(names[i], 0) % bucket_count].emplace_back(i);
+
+		std::vector<std::size_t> order(bucket_count);
+		for (std::size_t i = 0; i < bucket_count; ++i)
+			order[i] = i;
+
+		std::stable_sort(begin(order), end(order), [&](auto a, auto b) { return buckets[a].size() > buckets[b].size(); });
+
+		perfect_hash hash{
+			.seeds = std::vector<std::uint32_t>(bucket_count),
+			.names = std::vector<std::size_t>(positions),
+		};
+
+		std::vector<bool> taken(positions);
+		std::vector<std::size_t> candidate;
+
+		for (auto b : order)
+		{
+			const auto &bucket = buckets[b];
+			if (bucket.empty())
+				break;
+
+			// seed 0 is the bucket hash, so the search starts at 1
+			std::uint32_t seed = 1;
+			for (; seed < std::numeric_limits<std::uint32_t>::max(); ++seed)
+			{
+				candidate.clear();
+				for (auto name : bucket)
+				{
+					auto position = hash_name(names[name], seed) % positions;
+					if (taken[position] || std::find(begin(candidate), end(candidate), position) != end(candidate))
+						break;
+
+					candidate.emplace_back(position);
+				}
+
+				if (candidate.size() == bucket.size())
+					break;
+			}
+
+			if (candidate.size() != bucket.size())
+				throw std::runtime_error("Unable to build a perfect hash of the command names");
+
+			hash.seeds[b] = seed;
+			for (std::size_t i = 0; i < bucket.size(); ++i)
+			{
+				taken[candidate[i]] = true;
+				hash.names[candidate[i]] = bucket[i];
+			}
+		}
+
+		return hash;
+	}
+
+	std::size_t perfect_hash_position(const perfect_hash &hash, std::string_view name)
+	{
+		auto seed = hash.seeds[hash_name(name, 0) % hash.seeds.size()];
+		return hash_name(name, seed) % hash.names.size();
+	}
+
+	template <typename T>
+	void write_number_list(fmt::memory_buffer &out, const std::vector<T> &numbers)
+	{
+		for (std::size_t i = 0; i < numbers.size(); ++i)
+			fmt::format_to(std::back_inserter(out), "{0}{1},{2}", i % 16 == 0 ? "\t"sv : " "sv, numbers[i], i % 16 == 15 || i + 1 == numbers.size() ? "\n"sv : ""sv);
+	}
+
+	void write_proc_hash_table(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		std::vector<std::string_view> names;
+		for (const auto &block : plan.blocks)
+			for (const auto &section : block.sections)
+				for (const auto *command : section.commands)
+					names.emplace_back(command->name);
+
+		const auto hash = build_perfect_hash(names);
+		const auto command_type = index_type(names.size());
+
+		fmt::format_to(std::back_inserter(out), R"(
+#include <string.h>
+
+// vgen_get_proc finds commands through a minimal perfect hash of every command name the loader was generated from,
+// the first hash of a name picks a seed, the second hash with that seed gives the position holding the command
+static const {1} vgen_proc_seeds[{0}] = {{
+)",
+			hash.seeds.size(), index_type(*std::max_element(begin(hash.seeds), end(hash.seeds))));
+		write_number_list(out, hash.seeds);
+
+		fmt::format_to(std::back_inserter(out), "}};\n\nstatic const {0} vgen_proc_commands[{1}] = {{\n", command_type, hash.names.size());
+		write_number_list(out, hash.names);
+
+		// the hash numbers commands in plan order, which matches the dispatch table until a guard leaves commands out
+		fmt::format_to(std::back_inserter(out), "}};\n\n// the dispatch table slot of each command, vgen_command_count for commands whose guard is not defined\nstatic const {0} vgen_proc_slots[{1}] = {{\n", command_type, std::max<std::size_t>(names.size(), 1));
+		for (const auto &block : plan.blocks)
+		{
+			fmt::format_to(std::back_inserter(out), "#if {0}\n", block.condition);
+			for (const auto &section : block.sections)
+				for (const auto *command : section.commands)
+					fmt::format_to(std::back_inserter(out), "\tvgen_command_{0},\n", command->name);
+
+			fmt::format_to(std::back_inserter(out), "#else\n");
+			for (const auto &section : block.sections)
+				for (std::size_t i = 0; i < section.commands.size(); ++i)
+					fmt::format_to(std::back_inserter(out), "\tvgen_command_count,\n");
+
+			fmt::format_to(std::back_inserter(out), "#endif // {0}\n", block.condition);
+		}
+
+		fmt::format_to(std::back_inserter(out), R"(}};
+
+static uint32_t vgen_hash_name(const char *name, uint32_t seed)
+{{
+	uint32_t hash = 2166136261u ^ (seed * 2654435769u);
+	for (; *name; ++name)
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+
+	hash ^= hash >> 16;
+	hash *= 2246822507u;
+	hash ^= hash >> 13;
+	hash *= 3266489909u;
+	hash ^= hash >> 16;
+	return hash;
+}}
+
+// the dispatch table slot of the named command, vgen_command_count if the loader has no such command
+static size_t vgen_find_command(const char *name)
+{{
+	uint32_t seed = vgen_proc_seeds[vgen_hash_name(name, 0) % {0}u];
+	size_t command = vgen_proc_slots[vgen_proc_commands[vgen_hash_name(name, seed) % {1}u]];
+	if (command == vgen_command_count || strcmp(name, vgen_command_name(command)) != 0)
+		return vgen_command_count;
+
+	return command;
+}}
+)",
+			hash.seeds.size(), hash.names.size());
+	}
+
+	void write_module_preamble(fmt::memory_buffer &out)
+	{
+		fmt::format_to(std::back_inserter(out), R"(module;
+
+// the module only provides the dynamic interface, Vulkan types still come from vulkan.h
+#if !defined(VK_NO_PROTOTYPES)
+	#define VK_NO_PROTOTYPES
+#endif
+#include <vulkan/vulkan.h>
+)");
+	}
+
+	void write_module_interface(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		auto now = [] {
+			using namespace std::chrono;
+			return fmt::gmtime(system_clock::to_time_t(system_clock::now()));
+		};
+
+		fmt::format_to(std::back_inserter(out), R"(/*******************************************************************************
+This file was generated by vulkan_loader_generator on {0:%c} UTC
+For more information, see: https://github.com/oracleoftroy/vulkan_loader_generator
+
+C++20 module interface for the VK_NO_PROTOTYPES variant of the loader. Build it
+together with vulkan_loader_module.cpp and use `import vulkan_loader;` in place
+of including vulkan_loader.h. The functions and struct match the C interface.
+*******************************************************************************/
+
+)",
+			now());
+
+		write_module_preamble(out);
+
+		fmt::format_to(std::back_inserter(out), R"(
+export module vulkan_loader;
+
+export using ::PFN_vkGetInstanceProcAddr;
+export using ::VkInstance;
+export using ::VkDevice;
+
+export struct vgen_vulkan_api
+{{)");
+
+		for (const auto &block : plan.blocks)
+			write_struct_block_fields(out, block);
+
+		fmt::format_to(std::back_inserter(out), R"(}};
+
+export void vgen_init_vulkan_loader(PFN_vkGetInstanceProcAddr get_address, struct vgen_vulkan_api *vk);
+export void vgen_load_instance_procs(VkInstance instance, struct vgen_vulkan_api *vk);
+export void vgen_load_device_procs(VkDevice device, struct vgen_vulkan_api *vk);
+)");
+	}
+
+	void write_module_implementation(fmt::memory_buffer &out, const emission_plan &plan)
+	{
+		write_module_preamble(out);
+
+		fmt::format_to(std::back_inserter(out), "\nmodule vulkan_loader;\n\n");
+
+		write_init_function(out, init_style::api_struct);
+		fmt::format_to(std::back_inserter(out), "\n");
+		write_load_functions(out, plan, init_style::api_struct, ""sv);
+	}
+
+	void write_source(fmt::memory_buffer &out, const std::string_view vulkan_header_version, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands)
+	{
+		write_source(out, build_emission_plan(vulkan_header_version, features, extensions, commands));
+	}
+
+	std::size_t estimate_emitted_size(const command_data &command)
+	{
+		// the wrapper dominates, but the command is also loaded by both variants of the init functions
+		fmt::memory_buffer scratch;
+		write_command_definition(scratch, command, pfn_storage::shared);
+
+		for (auto style : {init_style::globals, init_style::api_struct})
+		{
+			if (!is_global_function(command.name))
+				write_command_init(scratch, command.name, init_target::instance, style);
+
+			if (command.is_device_command)
+				write_command_init(scratch, command.name, init_target::device, style);
+		}
+
+		return scratch.size();
+	}
+
+	std::vector<emission_plan> split_emission_plan(const emission_plan &plan, std::size_t shards)
+	{
+		if (shards == 0)
+			throw std::runtime_error("The loader must be split into at least one shard");
+
+		std::size_t total = 0;
+		std::unordered_map<const command_data *, std::size_t> sizes;
+		for (const auto &block : plan.blocks)
+			for (const auto &section : block.sections)
+				for (const auto *command : section.commands)
+					total += sizes[command] = estimate_emitted_size(*command);
+
+		std::vector<emission_plan> result(shards, emission_plan{.vulkan_header_version = plan.vulkan_header_version});
+
+		// the block and section each shard is currently appending to, so a block split across shards is guarded in each of them
+		constexpr auto none = std::numeric_limits<std::size_t>::max();
+		std::vector<std::pair<std::size_t, std::size_t>> current(shards, {none, none});
+
+		// commands are assigned in plan order, each going to the shard its midpoint falls in
+		std::size_t emitted = 0;
+		for (std::size_t b = 0; b < plan.blocks.size(); ++b)
+		{
+			const auto &block = plan.blocks[b];
+
+			for (std::size_t s = 0; s < block.sections.size(); ++s)
+			{
+				const auto &section = block.sections[s];
+
+				for (const auto *command : section.commands)
+				{
+					const auto size = sizes[command];
+					const auto shard = std::min(shards - 1, (emitted + size / 2) * shards / std::max<std::size_t>(total, 1));
+					emitted += size;
+
+					auto &shard_plan = result[shard];
+					if (current[shard].first != b)
+					{
+						auto &shard_block = shard_plan.blocks.emplace_back(block);
+						shard_block.sections.clear();
+						current[shard] = {b, none};
+					}
+
+					auto &shard_block = shard_plan.blocks.back();
+					if (current[shard].second != s)
+					{
+						shard_block.sections.emplace_back(plan_section{.comment = section.comment});
+						current[shard].second = s;
+					}
+
+					shard_block.sections.back().commands.emplace_back(command);
+				}
+			}
+		}
+
+		for (auto &shard_plan : result)
+			shard_plan.device_blocks = get_device_blocks(shard_plan.blocks);
+
+		return result;
+	}
+
+	void write_shard_declarations(fmt::memory_buffer &out, std::size_t shards, init_style style)
+	{
+		for (std::size_t i = 0; i < shards; ++i)
+		{
+			fmt::format_to(std::back_inserter(out), "void vgen_load_instance_procs_shard{0}(VkInstance instance{1});\n", i, load_function_params(style));
+			fmt::format_to(std::back_inserter(out), "void vgen_load_device_procs_shard{0}(VkDevice device{1});\n", i, load_function_params(style));
+		}
+	}
+
+	void write_shards_header(fmt::memory_buffer &out, const emission_plan &plan, std::size_t shards, const std::vector<header_unit> &units, loader_variant variant)
+	{
+		fmt::format_to(std::back_inserter(out), R"(#if !defined(VGEN_VULKAN_LOADER_SHARDS_HEADER)
+#define VGEN_VULKAN_LOADER_SHARDS_HEADER
+
+// Internal to the sharded vulkan_loader sources, do not include directly
+
+)");
+
+		write_source_preamble(out, plan.vulkan_header_version);
+
+		fmt::memory_buffer struct_declarations;
+		if (has_api_struct(variant))
+		{
+			if (!units.empty())
+			{
+				write_split_struct_definition(struct_declarations, units);
+				fmt::format_to(std::back_inserter(struct_declarations), "\n");
+			}
+
+			write_shard_declarations(struct_declarations, shards, init_style::api_struct);
+		}
+
+		fmt::memory_buffer prototype_declarations;
+		if (has_prototypes(variant))
+		{
+			fmt::format_to(std::back_inserter(prototype_declarations), "\n");
+			write_shard_declarations(prototype_declarations, shards, init_style::globals);
+
+			// every shard can reach every function pointer, the definition lives in the shard holding the wrapper
+			for (const auto &block : plan.blocks)
+				write_block_commands(prototype_declarations, block, [&](const command_data &command) { fmt::format_to(std::back_inserter(prototype_declarations), "extern PFN_{0} pfn_{0};\n", command.name); }, option_comments::no_comments);
+		}
+
+		write_source_variants(out, to_string(struct_declarations), to_string(prototype_declarations), variant);
+		fmt::format_to(std::back_inserter(out), "\n#endif // !defined(VGEN_VULKAN_LOADER_SHARDS_HEADER)\n");
+	}
+
+	void write_shard_source(fmt::memory_buffer &out, const emission_plan &shard_plan, std::size_t index, const std::vector<header_unit> &units, loader_variant variant)
+	{
+		const auto suffix = fmt::format("_shard{0}", index);
+
+		fmt::memory_buffer struct_loader;
+		if (has_api_struct(variant))
+			write_load_functions(struct_loader, shard_plan, init_style::api_struct, suffix, make_struct_layout(units));
+
+		fmt::memory_buffer prototype_loader;
+		if (has_prototypes(variant))
+		{
+			for (const auto &block : shard_plan.blocks)
+				write_block_definitions(prototype_loader, block, pfn_storage::shared);
+
+			fmt::format_to(std::back_inserter(prototype_loader), "\n");
+			write_load_functions(prototype_loader, shard_plan, init_style::globals, suffix);
+		}
+
+		fmt::format_to(std::back_inserter(out), "#include <vulkan_loader_shards.h>\n");
+		write_source_variants(out, to_string(struct_loader), to_string(prototype_loader), variant);
+	}
+
+	void write_shard_load_calls(fmt::memory_buffer &out, std::size_t shards, init_style style)
+	{
+		const auto vk = style == init_style::api_struct ? ", vk"sv : ""sv;
+
+		fmt::format_to(std::back_inserter(out), "void vgen_load_instance_procs(VkInstance instance{0})\n{{\n", load_function_params(style));
+		for (std::size_t i = 0; i < shards; ++i)
+			fmt::format_to(std::back_inserter(out), "\tvgen_load_instance_procs_shard{0}(instance{1});\n", i, vk);
+
+		fmt::format_to(std::back_inserter(out), "}}\n\nvoid vgen_load_device_procs(VkDevice device{0})\n{{\n", load_function_params(style));
+		for (std::size_t i = 0; i < shards; ++i)
+			fmt::format_to(std::back_inserter(out), "\tvgen_load_device_procs_shard{0}(device{1});\n", i, vk);
+
+		fmt::format_to(std::back_inserter(out), "}}\n");
+	}
+
+	void write_sharded_source(fmt::memory_buffer &out, std::size_t shards, const std::vector<header_unit> &units, loader_variant variant)
+	{
+		fmt::memory_buffer struct_loader;
+		if (has_api_struct(variant))
+		{
+			if (!units.empty())
+			{
+				write_split_struct_accessors(struct_loader, units);
+				fmt::format_to(std::back_inserter(struct_loader), "\n");
+			}
+
+			write_init_function(struct_loader, init_style::api_struct, make_struct_layout(units));
+			fmt::format_to(std::back_inserter(struct_loader), "\n");
+			write_shard_load_calls(struct_loader, shards, init_style::api_struct);
+		}
+
+		fmt::memory_buffer prototype_loader;
+		if (has_prototypes(variant))
+		{
+			fmt::format_to(std::back_inserter(prototype_loader), "\n");
+			write_init_function(prototype_loader, init_style::globals);
+			fmt::format_to(std::back_inserter(prototype_loader), "\n");
+			write_shard_load_calls(prototype_loader, shards, init_style::globals);
+		}
+
+		fmt::format_to(std::back_inserter(out), "#include <vulkan_loader_shards.h>\n");
+		write_source_variants(out, to_string(struct_loader), to_string(prototype_loader), variant);
+	}
+
+	emission_stats get_emission_stats(const emission_plan &plan)
+	{
+		emission_stats stats{
+			.total = {.name = "total"},
+		};
+
+		for (const auto &block : plan.blocks)
+		{
+			block_stats entry{
+				.name = block.name,
+				.kind = block.kind,
+			};
+
+			for (const auto &section : block.sections)
+			{
+				for (const auto *command : section.commands)
+				{
+					++entry.commands;
+					++entry.wrappers;
+
+					// counted the way write_blocks_init emits them, vgen_init_vulkan_loader alone loads the global functions
+					if (is_global_function(command->name))
+						++entry.global_init_calls;
+					else
+					{
+						++entry.instance_init_calls;
+
+						if (command->is_device_command)
+							++entry.device_init_calls;
+					}
+				}
+			}
+
+			fmt::memory_buffer header;
+			write_struct_block_fields(header, block);
+			entry.header_bytes = header.size();
+
+			// the same pieces write_source emits for this block in both variants
+			fmt::memory_buffer source;
+			write_block_definitions(source, block);
+
+			auto device_block = std::find_if(begin(plan.device_blocks), end(plan.device_blocks), [&](const auto &device) { return device.condition == block.condition; });
+
+			for (auto style : {init_style::globals, init_style::api_struct})
+			{
+				write_blocks_init(source, {block}, init_target::instance, style);
+				if (device_block != end(plan.device_blocks))
+					write_blocks_init(source, {*device_block}, init_target::device, style);
+			}
+
+			entry.source_bytes = source.size();
+
+			stats.total.commands += entry.commands;
+			stats.total.wrappers += entry.wrappers;
+			stats.total.global_init_calls += entry.global_init_calls;
+			stats.total.instance_init_calls += entry.instance_init_calls;
+			stats.total.device_init_calls += entry.device_init_calls;
+			stats.total.header_bytes += entry.header_bytes;
+			stats.total.source_bytes += entry.source_bytes;
+
+			stats.blocks.emplace_back(std::move(entry));
+		}
+
+		return stats;
+	}
+
+	void write_stats_text(fmt::memory_buffer &out, const emission_stats &stats)
+	{
+		auto write_row = [&](const block_stats &entry) {
+			fmt::format_to(std::back_inserter(out), "{0:>8} {1:>8} {2:>8} {3:>8} {4:>8} {5:>10} {6:>10}  {7}\n",
+				entry.commands, entry.wrappers, entry.global_init_calls, entry.instance_init_calls, entry.device_init_calls, entry.header_bytes, entry.source_bytes, entry.name);
+		};
+
+		fmt::format_to(std::back_inserter(out), "{0:>8} {1:>8} {2:>8} {3:>8} {4:>8} {5:>10} {6:>10}  {7}\n", "commands", "wrappers", "global", "instance", "device", "header", "source", "feature / extension group");
+
+		for (const auto &entry : stats.blocks)
+			write_row(entry);
+
+		write_row(stats.total);
+	}
+
+	std::string json_escape(std::string_view text)
+	{
+		std::string escaped;
+		for (auto c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+
+			escaped += c;
+		}
+
+		return escaped;
+	}
+
+	void write_stats_json(fmt::memory_buffer &out, const emission_stats &stats)
+	{
+		auto write_entry = [&](const block_stats &entry, std::string_view indent, std::string_view kind) {
+			fmt::format_to(std::back_inserter(out),
+				R"({0}{{"name": "{1}", {2}"commands": {3}, "wrappers": {4}, "global_init_calls": {5}, "instance_init_calls": {6}, "device_init_calls": {7}, "header_bytes": {8}, "source_bytes": {9}}})",
+				indent, json_escape(entry.name), kind, entry.commands, entry.wrappers, entry.global_init_calls, entry.instance_init_calls, entry.device_init_calls, entry.header_bytes, entry.source_bytes);
+		};
+
+		fmt::format_to(std::back_inserter(out), "{{\n\t\"blocks\": [\n");
+
+		for (std::size_t i = 0; i < stats.blocks.size(); ++i)
+		{
+			write_entry(stats.blocks[i], "\t\t"sv, stats.blocks[i].kind == block_kind::feature ? R"("kind": "feature", )"sv : R"("kind": "extension", )"sv);
+			fmt::format_to(std::back_inserter(out), "{0}\n", i + 1 < stats.blocks.size() ? ","sv : ""sv);
+		}
+
+		fmt::format_to(std::back_inserter(out), "\t],\n\t\"total\": ");
+		write_entry(stats.total, ""sv, ""sv);
+		fmt::format_to(std::back_inserter(out), "\n}}\n");
+	}
+
+	struct allocation_counters
+	{
+		std::atomic<std::size_t> count = 0;
+		std::atomic<std::size_t> bytes = 0;
+		std::atomic<std::size_t> live = 0;
+		std::atomic<std::size_t> peak = 0;
+	};
+
+	allocation_counters allocations;
+
+	// blocks carry their size in front of the returned pointer so frees can lower the live byte count
+	constexpr auto allocation_prefix = alignof(std::max_align_t);
+
+	void *counted_allocate(std::size_t size) noexcept
+	{
+		auto block = static_cast<std::byte *>(std::malloc(size + allocation_prefix));
+		if (!block)
+			return nullptr;
+
+		std::memcpy(block, &size, sizeof(size));
+
+		allocations.count.fetch_add(1, std::memory_order_relaxed);
+		allocations.bytes.fetch_add(size, std::memory_order_relaxed);
+
+		auto live = allocations.live.fetch_add(size, std::memory_order_relaxed) + size;
+		auto peak = allocations.peak.load(std::memory_order_relaxed);
+		while (live > peak && !allocations.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+			;
+
+		return block + allocation_prefix;
+	}
+
+	void counted_deallocate(void *ptr) noexcept
+	{
+		if (!ptr)
+			return;
+
+		auto block = static_cast<std::byte *>(ptr) - allocation_prefix;
+
+		std::size_t size;
+		std::memcpy(&size, block, sizeof(size));
+		allocations.live.fetch_sub(size, std::memory_order_relaxed);
+
+		std::free(block);
+	}
+
+	allocation_totals get_allocation_totals()
+	{
+		return {
+			.count = allocations.count.load(std::memory_order_relaxed),
+			.bytes = allocations.bytes.load(std::memory_order_relaxed),
+			.live = allocations.live.load(std::memory_order_relaxed),
+			.peak = allocations.peak.load(std::memory_order_relaxed),
+		};
+	}
+
+	void reset_allocation_peak()
+	{
+		allocations.peak.store(allocations.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	void begin_phase(phase_timings &timings, std::string name)
+	{
+		reset_allocation_peak();
+
+		timings.allocations_start = get_allocation_totals();
+		timings.cpu_start = std::clock();
+		timings.wall_start = std::chrono::steady_clock::now();
+
+		if (timings.phases.empty())
+			timings.origin = timings.wall_start;
+
+		timings.phases.emplace_back(phase_timing{
+			.name = std::move(name),
+			.start = timings.wall_start - timings.origin,
+		});
+	}
+
+	void end_phase(phase_timings &timings, std::size_t output_bytes)
+	{
+		auto wall_end = std::chrono::steady_clock::now();
+		auto cpu_end = std::clock();
+		auto allocations_end = get_allocation_totals();
+
+		auto &phase = timings.phases.back();
+		phase.wall = wall_end - timings.wall_start;
+		phase.cpu = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(static_cast<double>(cpu_end - timings.cpu_start) / CLOCKS_PER_SEC));
+		phase.allocations = allocations_end.count - timings.allocations_start.count;
+		phase.allocated_bytes = allocations_end.bytes - timings.allocations_start.bytes;
+		phase.peak_bytes = allocations_end.peak > timings.allocations_start.live ? allocations_end.peak - timings.allocations_start.live : 0;
+		phase.output_bytes = output_bytes;
+	}
+
+	phase_timing get_timings_total(const phase_timings &timings)
+	{
+		phase_timing total{.name = "total"};
+
+		if (!timings.phases.empty())
+			total.wall = timings.phases.back().start + timings.phases.back().wall - timings.phases.front().start;
+
+		for (const auto &phase : timings.phases)
+		{
+			total.cpu += phase.cpu;
+			total.allocations += phase.allocations;
+			total.allocated_bytes += phase.allocated_bytes;
+			total.peak_bytes = std::max(total.peak_bytes, phase.peak_bytes);
+			total.output_bytes += phase.output_bytes;
+		}
+
+		return total;
+	}
+
+	void write_timings_text(fmt::memory_buffer &out, const phase_timings &timings)
+	{
+		auto milliseconds = [](std::chrono::nanoseconds duration) {
+			return std::chrono::duration<double, std::milli>(duration).count();
+		};
+
+		auto write_row = [&](const phase_timing &phase) {
+			fmt::format_to(std::back_inserter(out), "{0:>10.3f} {1:>10.3f} {2:>10} {3:>12} {4:>12} {5:>12}  {6}\n",
+				milliseconds(phase.wall), milliseconds(phase.cpu), phase.allocations, phase.allocated_bytes, phase.peak_bytes, phase.output_bytes, phase.name);
+		};
+
+		fmt::format_to(std::back_inserter(out), "{0:>10} {1:>10} {2:>10} {3:>12} {4:>12} {5:>12}  {6}\n", "wall ms", "cpu ms", "allocs", "alloc bytes", "peak bytes", "output bytes", "phase");
+
+		for (const auto &phase : timings.phases)
+			write_row(phase);
+
+		write_row(get_timings_total(timings));
+	}
+
+	void write_timings_json(fmt::memory_buffer &out, const phase_timings &timings)
+	{
+		auto write_entry = [&](const phase_timing &phase, std::string_view indent) {
+			fmt::format_to(std::back_inserter(out),
+				R"({0}{{"name": "{1}", "start_ns": {2}, "wall_ns": {3}, "cpu_ns": {4}, "allocations": {5}, "allocated_bytes": {6}, "peak_bytes": {7}, "output_bytes": {8}}})",
+				indent, json_escape(phase.name), phase.start.count(), phase.wall.count(), phase.cpu.count(), phase.allocations, phase.allocated_bytes, phase.peak_bytes, phase.output_bytes);
+		};
+
+		fmt::format_to(std::back_inserter(out), "{{\n\t\"phases\": [\n");
+
+		for (std::size_t i = 0; i < timings.phases.size(); ++i)
+		{
+			write_entry(timings.phases[i], "\t\t"sv);
+			fmt::format_to(std::back_inserter(out), "{0}\n", i + 1 < timings.phases.size() ? ","sv : ""sv);
+		}
+
+		fmt::format_to(std::back_inserter(out), "\t],\n\t\"total\": ");
+		write_entry(get_timings_total(timings), ""sv);
+		fmt::format_to(std::back_inserter(out), "\n}}\n");
+	}
+
+	// Chrome trace event format, complete events with microsecond timestamps, loads in chrome://tracing and Perfetto
+	void write_timings_trace(fmt::memory_buffer &out, const phase_timings &timings)
+	{
+		auto microseconds = [](std::chrono::nanoseconds duration) {
+			return std::chrono::duration<double, std::micro>(duration).count();
+		};
+
+		fmt::format_to(std::back_inserter(out), "{{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [\n");
+
+		for (std::size_t i = 0; i < timings.phases.size(); ++i)
+		{
+			const auto &phase = timings.phases[i];
+			fmt::format_to(std::back_inserter(out),
+				R"(		{{"name": "{0}", "cat": "vgen", "ph": "X", "pid": 1, "tid": 1, "ts": {1:.3f}, "dur": {2:.3f}, "args": {{"cpu_us": {3:.3f}, "allocations": {4}, "allocated_bytes": {5}, "peak_bytes": {6}, "output_bytes": {7}}}}}{8})"
+				"\n",
+				json_escape(phase.name), microseconds(phase.start), microseconds(phase.wall), microseconds(phase.cpu), phase.allocations, phase.allocated_bytes, phase.peak_bytes, phase.output_bytes,
+				i + 1 < timings.phases.size() ? ","sv : ""sv);
+		}
+
+		fmt::format_to(std::back_inserter(out), "\t]\n}}\n");
+	}
+
+	// clang-format off
+	template <typename Fn>
+	requires std::is_invocable_v<Fn, fmt::memory_buffer &>
+	std::future<std::string> render(Fn writer)
+	// clang-format on
+	{
+		return std::async(std::launch::async, [writer] {
+			fmt::memory_buffer out;
+			writer(out);
+			return to_string(out);
+		});
+	}
+
+	std::vector<generated_file> render_headers(const emission_plan &plan, const std::vector<header_unit> &units, loader_variant variant, const generator_options &options)
+	{
+		fmt::memory_buffer out;
+
+		if (units.empty())
+		{
+			write_header(out, plan, variant, options);
+			return {{.name = "vulkan_loader.h", .contents = to_string(out)}};
+		}
+
+		write_core_header(out, units, variant);
+		std::vector<generated_file> files{{.name = "vulkan_loader.h", .contents = to_string(out)}};
+
+		for (const auto &unit : units)
+		{
+			out.clear();
+			write_unit_header(out, unit);
+			files.emplace_back(generated_file{.name = unit_header_name(unit), .contents = to_string(out)});
+		}
+
+		return files;
+	}
+
+	std::vector<generated_file> render_sources(const emission_plan &plan, const generator_options &options, const std::vector<header_unit> &units, loader_variant variant)
+	{
+		if (options.shards <= 1)
+		{
+			// only render the variants that are emitted
+			std::future<std::string> struct_loader;
+			if (has_api_struct(variant))
+				struct_loader = render([&](fmt::memory_buffer &out) { write_struct_loader(out, plan, units, options); });
+
+			std::future<std::string> prototype_loader;
+			if (has_prototypes(variant))
+				prototype_loader = render([&](fmt::memory_buffer &out) { write_prototype_loader(out, plan, options); });
+
+			fmt::memory_buffer source;
+			write_source_start(source, plan, options);
+			write_source_variants(source, struct_loader.valid() ? struct_loader.get() : ""s, prototype_loader.valid() ? prototype_loader.get() : ""s, variant);
+
+			return {{.name = "vulkan_loader.c", .contents = to_string(source)}};
+		}
+
+		const auto shard_plans = split_emission_plan(plan, options.shards);
+
+		auto shards_header = render([&](fmt::memory_buffer &out) { write_shards_header(out, plan, options.shards, units, variant); });
+		auto source = render([&](fmt::memory_buffer &out) { write_sharded_source(out, options.shards, units, variant); });
+
+		std::vector<std::future<std::string>> shards;
+		for (std::size_t i = 0; i < shard_plans.size(); ++i)
+			shards.emplace_back(render([&, i](fmt::memory_buffer &out) { write_shard_source(out, shard_plans[i], i, units, variant); }));
+
+		std::vector<generated_file> files{
+			{.name = "vulkan_loader_shards.h", .contents = shards_header.get()},
+			{.name = "vulkan_loader.c", .contents = source.get()},
+		};
+
+		for (std::size_t i = 0; i < shards.size(); ++i)
+			files.emplace_back(generated_file{.name = fmt::format("vulkan_loader_shard{0}.c", i), .contents = shards[i].get()});
+
+		return files;
+	}
+
+	std::vector<generated_file> render_variant(const emission_plan &plan, const generator_options &options, loader_variant variant)
+	{
+		// the unit headers only hold struct fields, the prototype interface has nothing to split
+		const auto units = options.split_headers && has_api_struct(variant) ? get_header_units(plan) : std::vector<header_unit>{};
+
+		auto headers = std::async(std::launch::async, [&] { return render_headers(plan, units, variant, options); });
+		auto sources = render_sources(plan, options, units, variant);
+
+		auto files = headers.get();
+		files.insert(end(files), std::make_move_iterator(begin(sources)), std::make_move_iterator(end(sources)));
+
+		return files;
+	}
+
+	std::vector<generated_file> generate_loader(const emission_plan &plan, const generator_options &options)
+	{
+		// the other layouts address function pointers by name from more than one file
+		if (options.init == init_mode::table && (options.shards > 1 || options.split_headers || options.cpp_module))
+			throw std::runtime_error("The table init mode can't be combined with shards, split headers, or the C++ module");
+
+		// the trampolines and the pointers they fill are private to one source
+		if (options.init == init_mode::lazy && options.shards > 1)
+			throw std::runtime_error("The lazy init mode can't be combined with shards");
+
+		// the device tables and the wrappers reading them are private to one source
+		if (options.device_dispatch && (options.init != init_mode::unrolled || options.shards > 1))
+			throw std::runtime_error("Per device dispatch needs the unrolled init mode in a single source");
+
+		// the pointers are shared with the header, and the device dispatch wrappers would be bypassed
+		if (options.inline_dispatch && (options.init == init_mode::table || options.device_dispatch || options.shards > 1))
+			throw std::runtime_error("Inline dispatch needs the unrolled or lazy init mode in a single source, without per device dispatch");
+
+		// the stubs fill the pointers the unrolled load functions of a single source assign
+		if (options.not_present_stubs && (options.init != init_mode::unrolled || options.device_dispatch || options.shards > 1))
+			throw std::runtime_error("Not present stubs need the unrolled init mode in a single source, without per device dispatch");
+
+		// the other modes and shards have load functions of their own
+		if (options.share_alias_slots && (options.init != init_mode::unrolled || options.device_dispatch || options.thread_safe || options.load_enabled_extensions || options.shards > 1 || options.cpp_module))
+			throw std::runtime_error("Sharing alias slots needs the unrolled init mode in a single source, without per device dispatch, the thread safe loader, the _ex load functions or a C++ module");
+
+		// the _ex load functions are written next to the unrolled load functions of a single source and header
+		if (options.load_enabled_extensions && (options.init != init_mode::unrolled || options.device_dispatch || options.thread_safe || options.shards > 1 || options.split_headers || options.cpp_module))
+			throw std::runtime_error("Loading the enabled extensions needs the unrolled init mode in a single source and header, without per device dispatch, the thread safe loader or a C++ module");
+
+		// the atomics and the once guards only cover the plain unrolled loader
+		if (options.thread_safe && (options.init != init_mode::unrolled || options.device_dispatch || options.inline_dispatch || options.not_present_stubs || options.shards > 1))
+			throw std::runtime_error("The thread safe loader needs the unrolled init mode in a single source, without per device dispatch, inline dispatch or not present stubs");
+
+		// the wrappers waiting for the background load and the load functions starting it only replace the plain unrolled loader
+		if (options.async_device_load && (options.init != init_mode::unrolled || options.device_dispatch || options.inline_dispatch || options.not_present_stubs || options.thread_safe || options.load_enabled_extensions || options.share_alias_slots || options.shards > 1 || options.split_headers))
+			throw std::runtime_error("Async device loading needs the unrolled init mode in a single source and header, without the other prototype variant options");
+
+		if (!options.hot_commands.empty() && !options.async_device_load)
+			throw std::runtime_error("Hot commands are loaded ahead of the others by vgen_load_device_procs_async, generate with async device loading");
+
+		for (const auto &command : options.hot_commands)
+		{
+			// the global and loader functions are never deferred, so listing them changes nothing
+			if (is_global_function(command) || is_loader_function(command) || filter_device_blocks(plan, [&](const command_data &device_command) { return device_command.name == command; }).empty())
+				throw std::runtime_error(fmt::format("The hot command {0} is not a device command the background load defers", command));
+		}
+
+		if (options.proc_lookup && options.init != init_mode::table)
+			throw std::runtime_error("vgen_get_proc looks up the dispatch table of the table init mode, generate with that mode");
+
+		if (options.availability && options.init != init_mode::table)
+			throw std::runtime_error("The availability bitsets are built from the dispatch table of the table init mode, generate with that mode");
+
+		std::future<std::string> module_interface;
+		std::future<std::string> module_implementation;
+		if (options.cpp_module)
+		{
+			module_interface = render([&](fmt::memory_buffer &out) { write_module_interface(out, plan); });
+			module_implementation = render([&](fmt::memory_buffer &out) { write_module_implementation(out, plan); });
+		}
+
+		std::vector<generated_file> files;
+
+		if (options.separate_variants)
+		{
+			// each variant gets its own directory so the generated includes need no changes
+			auto prototypes = std::async(std::launch::async, [&] { return render_variant(plan, options, loader_variant::prototypes); });
+			auto api_struct = render_variant(plan, options, loader_variant::api_struct);
+
+			for (auto &file : prototypes.get())
+				files.emplace_back(generated_file{.name = "prototypes/" + file.name, .contents = std::move(file.contents)});
+
+			for (auto &file : api_struct)
+				files.emplace_back(generated_file{.name = "struct/" + file.name, .contents = std::move(file.contents)});
+		}
+		else
+			files = render_variant(plan, options, options.variant);
+
+		if (options.cpp_module)
+		{
+			files.emplace_back(generated_file{.name = "vulkan_loader.cppm", .contents = module_interface.get()});
+			files.emplace_back(generated_file{.name = "vulkan_loader_module.cpp", .contents = module_implementation.get()});
+		}
+
+		return files;
 	}
 }
@@ -1,11 +1,19 @@
+#pragma once
+
 #include <fmt/format.h>
 #include <pugixml.hpp>
 
+#include <chrono>
+#include <compare>
+#include <cstdint>
+#include <ctime>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace vgen
 {
@@ -18,6 +26,9 @@ namespace vgen
 		std::string comment;
 		bool returns_void;
 		bool is_device_command;
+
+		// the command this one is an alias of, empty for commands that aren't aliases
+		std::string alias_of = {};
 	};
 
 	struct section_data
@@ -37,6 +48,252 @@ namespace vgen
 	using command_map = std::unordered_map<std::string, command_data>;
 	using extension_map = std::multimap<std::set<std::string>, std::string>;
 
+	struct version_number
+	{
+		unsigned major = 0;
+		unsigned minor = 0;
+
+		auto operator<=>(const version_number &) const = default;
+	};
+
+	// limits the registry to the features and extensions a loader is generated for
+	struct registry_filter
+	{
+		// features newer than this are dropped, all features are kept when unset
+		std::optional<version_number> api_version;
+
+		// glob patterns ('*' and '?') of extensions to keep, all extensions are kept when empty
+		std::vector<std::string> extensions;
+
+		// glob patterns of extensions to drop, applied after extensions
+		std::vector<std::string> exclude_extensions;
+	};
+
+	enum class block_kind
+	{
+		feature,
+		extension,
+	};
+
+	struct plan_section
+	{
+		std::string comment;
+		std::vector<const command_data *> commands;
+	};
+
+	// a group of commands emitted under a single preprocessor guard
+	struct plan_block
+	{
+		block_kind kind;
+		std::string name; // feature name, or the guard condition for extension groups
+		std::string condition;
+		std::set<std::string> requirements;
+		std::string comment;
+
+		std::vector<plan_section> sections;
+	};
+
+	// The emission plan is built once from the registry model and shared by all output backends.
+	// Commands point into the command_map used to build the plan, so it must outlive the plan.
+	struct emission_plan
+	{
+		std::string vulkan_header_version;
+
+		// features in registry order followed by extension groups in extension_map order
+		std::vector<plan_block> blocks;
+
+		// the subset of blocks containing device level commands
+		std::vector<plan_block> device_blocks;
+	};
+
+	// a single generated header holding the struct fields of one feature or of the extension groups filed under one extension
+	// blocks point into the emission plan the unit was made from
+	struct header_unit
+	{
+		std::string name;
+		std::string guard;
+		std::vector<const plan_block *> blocks;
+	};
+
+	// what one feature or extension group contributes to the generated loader
+	struct block_stats
+	{
+		std::string name;
+		block_kind kind = block_kind::feature;
+
+		std::size_t commands = 0;
+
+		// prototype variant wrappers
+		std::size_t wrappers = 0;
+
+		// vkGet*ProcAddr calls made by vgen_init_vulkan_loader, vgen_load_instance_procs, and vgen_load_device_procs
+		std::size_t global_init_calls = 0;
+		std::size_t instance_init_calls = 0;
+		std::size_t device_init_calls = 0;
+
+		// bytes of struct fields in the header and of definitions plus init code in the source, both variants
+		std::size_t header_bytes = 0;
+		std::size_t source_bytes = 0;
+	};
+
+	struct emission_stats
+	{
+		std::vector<block_stats> blocks;
+		block_stats total;
+	};
+
+	// allocations made through counted_allocate
+	struct allocation_totals
+	{
+		std::size_t count = 0;
+		std::size_t bytes = 0;
+
+		// bytes allocated and not yet freed, and the most that were live at once since reset_allocation_peak
+		std::size_t live = 0;
+		std::size_t peak = 0;
+	};
+
+	// what one step of a generator run cost
+	struct phase_timing
+	{
+		std::string name;
+
+		// start is relative to the first phase, cpu time is for the whole process so it includes worker threads
+		std::chrono::nanoseconds start = {};
+		std::chrono::nanoseconds wall = {};
+		std::chrono::nanoseconds cpu = {};
+
+		// zero unless the program routes its allocations through counted_allocate
+		std::size_t allocations = 0;
+		std::size_t allocated_bytes = 0;
+		std::size_t peak_bytes = 0; // most bytes live at once during the phase, above what was live when it began
+
+		// bytes of output the phase produced, the total adds them up, so only the phase producing them counts them
+		std::size_t output_bytes = 0;
+	};
+
+	struct phase_timings
+	{
+		std::vector<phase_timing> phases;
+
+		// state of the phase begin_phase started
+		std::chrono::steady_clock::time_point origin = {};
+		std::chrono::steady_clock::time_point wall_start = {};
+		std::clock_t cpu_start = 0;
+		allocation_totals allocations_start = {};
+	};
+
+	struct generated_file
+	{
+		std::string name;
+		std::string contents;
+	};
+
+	// which interfaces of vulkan_loader.h are generated, selected by VK_NO_PROTOTYPES at compile time
+	enum class loader_variant
+	{
+		both,
+		prototypes, // implements the vulkan.h prototypes
+		api_struct, // fills struct vgen_vulkan_api, requires VK_NO_PROTOTYPES
+	};
+
+	// how the generated load functions fill in the function pointers
+	enum class init_mode
+	{
+		unrolled, // one vkGet*ProcAddr call and name literal per command
+		table,    // a loop over a packed name table fills an array backed dispatch table indexed by enum vgen_command
+		lazy,     // prototype variant pointers start as trampolines resolving the command on first call, the struct variant stays unrolled
+	};
+
+	struct generator_options
+	{
+		// number of translation units the loader source is split across
+		std::size_t shards = 1;
+
+		// emit a core header with an opaque function table plus one header per feature and extension
+		bool split_headers = false;
+
+		// also emit a C++20 module interface and implementation unit for the dynamic interface
+		bool cpp_module = false;
+
+		loader_variant variant = loader_variant::both;
+
+		// write each variant to its own file set under prototypes/ and struct/, ignores variant
+		bool separate_variants = false;
+
+		// table requires a single source without split headers or a C++ module, lazy a single source
+		init_mode init = init_mode::unrolled;
+
+		// table init only, also emit vgen_get_proc to look up loaded function pointers by name
+		bool proc_lookup = false;
+
+		// table init only, the load functions also record which commands and which requirement groups they resolved in full,
+		// queried with vgen_has_command and vgen_has_group
+		bool availability = false;
+
+		// unrolled init in a single source only, the prototype variant keeps the device level commands of every loaded device
+		// and routes each wrapper through the table of the device its first parameter belongs to
+		bool device_dispatch = false;
+
+		// unrolled or lazy init in a single source only, the header maps every prototype to its function pointer
+		// so calls go straight through the pointer instead of through the out of line wrapper
+		bool inline_dispatch = false;
+
+		// unrolled init in a single source without per device dispatch only, commands of the prototype variant that fail
+		// to load call a typed stub returning VK_ERROR_EXTENSION_NOT_PRESENT, so the wrappers need no check
+		bool not_present_stubs = false;
+
+		// unrolled init in a single source without the other prototype options only, the prototype variant keeps its
+		// pointers in C11 atomics and concurrent calls of a load function share one load
+		bool thread_safe = false;
+
+		// unrolled init in a single source and header only, also emit vgen_load_instance_procs_ex and vgen_load_device_procs_ex
+		// which only load the commands of the Vulkan versions up to the api version and of the extensions they are given
+		bool load_enabled_extensions = false;
+
+		// unrolled init in a single source only, the load functions look up the aliases of a command once, trying the
+		// promoted name first, and fill every alias with whichever name the driver has
+		bool share_alias_slots = false;
+
+		// unrolled init in a single source and header without the other prototype options only, also emit
+		// vgen_load_device_procs_async, which resolves the device commands of the prototype variant on a background thread
+		// while their wrappers wait for it only when called before it is done
+		bool async_device_load = false;
+
+		// async device load only, device commands vgen_load_device_procs_async resolves on the calling thread before it
+		// returns, so their wrappers never wait, e.g. the vkCmd* commands of the first frame
+		std::vector<std::string> hot_commands = {};
+	};
+
+	// a minimal perfect hash of a set of names, each name hashes to its own position in [0, number of names)
+	struct perfect_hash
+	{
+		// the first hash of a name picks its bucket, the bucket's seed makes the second hash land on a free position
+		std::vector<std::uint32_t> seeds;
+
+		// index of the name that hashes to each position
+		std::vector<std::size_t> names;
+	};
+
+	// which load function loads a command, through vkGetInstanceProcAddr or vkGetDeviceProcAddr
+	enum class init_target
+	{
+		instance,
+		device,
+	};
+
+	enum class pfn_storage
+	{
+		file_scope, // static, private to the generated source
+		shared,     // external linkage, shared between source shards
+	};
+
+	enum class alias_loading
+	{
+		separate, // every command is looked up under its own name
+		shared,   // the aliases of a command are resolved once, whichever name the driver has fills all of them
+	};
+
 	command_map read_commands(const pugi::xml_document &doc);
 	std::vector<feature_data> read_features(const pugi::xml_document &doc);
 
@@ -53,7 +310,7 @@ namespace vgen
 
 	void write_guard_start(fmt::memory_buffer &out, const std::string &guard);
 	void write_guard_end(fmt::memory_buffer &out, const std::string &guard);
-	void write_command_definition(fmt::memory_buffer &out, const command_data &command);
+	void write_command_definition(fmt::memory_buffer &out, const command_data &command, pfn_storage storage = pfn_storage::file_scope);
 	void write_feature_definitions(fmt::memory_buffer &out, const feature_data &feature, const command_map &commands);
 	void write_extension_definitions(fmt::memory_buffer &out, const extension_map &extensions, const command_map &commands);
 
@@ -62,19 +319,142 @@ namespace vgen
 	void write_struct_feature_fields(fmt::memory_buffer &out, const feature_data &feature, const command_map &commands);
 	void write_struct_extension_fields(fmt::memory_buffer &out, const extension_map &extensions, const command_map &commands);
 
-	void write_feature_instance_init(fmt::memory_buffer &out, const feature_data &feature);
-	void write_feature_device_init(fmt::memory_buffer &out, const feature_data &feature);
-	void write_extensions_instance_init(fmt::memory_buffer &out, const extension_map &extensions);
-	void write_extensions_device_init(fmt::memory_buffer &out, const extension_map &extensions);
-
-	void write_feature_instance_init_struct(fmt::memory_buffer &out, const feature_data &feature);
-	void write_feature_device_init_struct(fmt::memory_buffer &out, const feature_data &feature);
-	void write_extensions_instance_init_struct(fmt::memory_buffer &out, const extension_map &extensions);
-	void write_extensions_device_init_struct(fmt::memory_buffer &out, const extension_map &extensions);
-
 	void write_header(fmt::memory_buffer &out, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands);
 	void write_source(fmt::memory_buffer &out, std::string_view vulkan_header_version, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands);
 
-	std::vector<feature_data> get_device_features(const std::vector<feature_data> &features, const command_map &commands);
-	extension_map get_device_extensions(const extension_map &extensions, const command_map &commands);
+	plan_block make_feature_block(const feature_data &feature, const command_map &commands);
+	std::vector<plan_block> make_extension_blocks(const extension_map &extensions, const command_map &commands);
+	std::vector<plan_block> get_device_blocks(const std::vector<plan_block> &blocks);
+	emission_plan build_emission_plan(std::string_view vulkan_header_version, const std::vector<feature_data> &features, const extension_map &extensions, const command_map &commands);
+
+	void write_block_definitions(fmt::memory_buffer &out, const plan_block &block, pfn_storage storage = pfn_storage::file_scope);
+	void write_struct_block_fields(fmt::memory_buffer &out, const plan_block &block);
+
+	// the loads of the commands of a block by the instance or the device load function, into the prototype variant pointers
+	// or into struct vgen_vulkan_api, vgen_init_vulkan_loader loads the global functions
+	void write_block_init(fmt::memory_buffer &out, const plan_block &block, init_target target);
+	void write_struct_block_init(fmt::memory_buffer &out, const plan_block &block, init_target target);
+
+	void write_header(fmt::memory_buffer &out, const emission_plan &plan, loader_variant variant = loader_variant::both, const generator_options &options = {});
+	void write_source_struct_loader(fmt::memory_buffer &out, const emission_plan &plan, const std::vector<header_unit> &units = {}, alias_loading aliases = alias_loading::separate);
+	void write_source_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, pfn_storage storage = pfn_storage::file_scope, alias_loading aliases = alias_loading::separate);
+	void write_source(fmt::memory_buffer &out, const emission_plan &plan, const std::vector<header_unit> &units = {}, loader_variant variant = loader_variant::both, const generator_options &options = {});
+
+	// pieces of the table init mode, the enum goes in the header, the name table in the source ahead of both variants
+	void write_command_enum(fmt::memory_buffer &out, const emission_plan &plan);
+	void write_command_name_table(fmt::memory_buffer &out, const emission_plan &plan);
+	void write_table_command_definition(fmt::memory_buffer &out, const command_data &command);
+	void write_source_table_struct_loader(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options = {});
+	void write_source_table_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options = {});
+
+	// pieces of the availability bitsets of the table init mode, the group enum goes in the header, the group table in the source
+	// the name of a group is its feature, or the names its extension group requires, e.g. VK_KHR_a_and_VK_VERSION_1_1_or_VK_KHR_b
+	std::string get_group_name(const plan_block &block);
+	void write_group_enum(fmt::memory_buffer &out, const emission_plan &plan);
+	void write_group_table(fmt::memory_buffer &out, const emission_plan &plan);
+
+	// FNV-1a with the murmur3 finalizer, the generated vgen_get_proc computes the same hash
+	std::uint32_t hash_name(std::string_view name, std::uint32_t seed);
+
+	// the same names in the same order always give the same hash, names must be unique
+	perfect_hash build_perfect_hash(const std::vector<std::string_view> &names);
+
+	// only meaningful for names the hash was built from, any other name lands on some position too
+	std::size_t perfect_hash_position(const perfect_hash &hash, std::string_view name);
+
+	void write_proc_hash_table(fmt::memory_buffer &out, const emission_plan &plan);
+
+	// pieces of the lazy init mode
+	void write_lazy_command_definition(fmt::memory_buffer &out, const command_data &command, pfn_storage storage = pfn_storage::file_scope);
+	void write_source_lazy_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, pfn_storage storage = pfn_storage::file_scope);
+
+	// pieces of the per device dispatch of the prototype variant
+	void write_device_table(fmt::memory_buffer &out, const emission_plan &plan);
+	void write_device_dispatch_command_definition(fmt::memory_buffer &out, const command_data &command);
+	void write_source_device_dispatch_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan);
+
+	// the header declarations of the inline dispatch of the prototype variant
+	void write_inline_dispatch(fmt::memory_buffer &out, const emission_plan &plan);
+
+	// pieces of the prototype variant falling back to not present stubs
+	void write_not_present_stub(fmt::memory_buffer &out, const command_data &command);
+	void write_stub_command_definition(fmt::memory_buffer &out, const command_data &command, pfn_storage storage = pfn_storage::file_scope);
+	void write_source_stub_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, pfn_storage storage = pfn_storage::file_scope, alias_loading aliases = alias_loading::separate);
+
+	// pieces of the thread safe prototype variant
+	void write_atomic_command_definition(fmt::memory_buffer &out, const command_data &command);
+	void write_source_atomic_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan);
+
+	// pieces of the prototype variant loading its device commands in the background
+	void write_async_command_definition(fmt::memory_buffer &out, const command_data &command);
+	void write_source_async_prototype_loader(fmt::memory_buffer &out, const emission_plan &plan, const generator_options &options);
+
+	// the commands of the blocks that are aliases of each other, the promoted command first, in order of first appearance
+	// only commands with an alias among the blocks are in a family
+	std::vector<std::vector<const command_data *>> get_alias_families(const std::vector<plan_block> &blocks);
+
+	// the runtime test of the _ex load functions for the api version and the enabled extensions a block needs
+	// empty for blocks Vulkan 1.0 alone satisfies, which are loaded regardless
+	std::string get_enabled_condition(const plan_block &block);
+
+	// returns the extension names tested by a requirement, e.g. "defined(A) && defined(B)" -> {A, B}
+	std::vector<std::string> requirement_names(std::string_view requirement);
+	std::vector<header_unit> get_header_units(const emission_plan &plan);
+	std::string unit_header_name(const header_unit &unit);
+	void write_core_header(fmt::memory_buffer &out, const std::vector<header_unit> &units, loader_variant variant = loader_variant::both);
+	void write_unit_header(fmt::memory_buffer &out, const header_unit &unit);
+
+	void write_module_interface(fmt::memory_buffer &out, const emission_plan &plan);
+	void write_module_implementation(fmt::memory_buffer &out, const emission_plan &plan);
+
+	// splits the plan into contiguous shards of roughly equal emitted size
+	std::vector<emission_plan> split_emission_plan(const emission_plan &plan, std::size_t shards);
+	void write_shards_header(fmt::memory_buffer &out, const emission_plan &plan, std::size_t shards, const std::vector<header_unit> &units = {}, loader_variant variant = loader_variant::both);
+	void write_shard_source(fmt::memory_buffer &out, const emission_plan &shard_plan, std::size_t index, const std::vector<header_unit> &units = {}, loader_variant variant = loader_variant::both);
+	void write_sharded_source(fmt::memory_buffer &out, std::size_t shards, const std::vector<header_unit> &units = {}, loader_variant variant = loader_variant::both);
+
+	emission_stats get_emission_stats(const emission_plan &plan);
+	void write_stats_text(fmt::memory_buffer &out, const emission_stats &stats);
+	void write_stats_json(fmt::memory_buffer &out, const emission_stats &stats);
+	std::string json_escape(std::string_view text);
+
+	// allocation counting hooks, a program opts in by forwarding its replacement operator new and delete to these
+	// pugixml can be routed through them with pugi::set_memory_management_functions
+	void *counted_allocate(std::size_t size) noexcept;
+	void counted_deallocate(void *ptr) noexcept;
+	allocation_totals get_allocation_totals();
+	void reset_allocation_peak();
+
+	// phases don't nest, each begin_phase is followed by one end_phase
+	void begin_phase(phase_timings &timings, std::string name);
+	void end_phase(phase_timings &timings, std::size_t output_bytes = 0);
+	phase_timing get_timings_total(const phase_timings &timings);
+	void write_timings_text(fmt::memory_buffer &out, const phase_timings &timings);
+	void write_timings_json(fmt::memory_buffer &out, const phase_timings &timings);
+	void write_timings_trace(fmt::memory_buffer &out, const phase_timings &timings);
+
+	// renders all output files concurrently from the same plan
+	std::vector<generated_file> generate_loader(const emission_plan &plan, const generator_options &options = {});
+
+	bool glob_match(std::string_view pattern, std::string_view text);
+
+	// parses "major.minor"
+	std::optional<version_number> parse_version(std::string_view version);
+
+	// the version of a feature named like VK_VERSION_1_2
+	std::optional<version_number> feature_version(std::string_view feature_name);
+
+	std::vector<feature_data> filter_features(const std::vector<feature_data> &features, const registry_filter &filter);
+	extension_map filter_extensions(const extension_map &extensions, const registry_filter &filter);
+
+	// returns the names of commands used in text, either directly (vkCmdDraw) or through their function pointer type (PFN_vkCmdDraw)
+	// text can be source code or the contents of an object file, ELF, Mach-O (_vkCmdDraw) or COFF (__imp_vkCmdDraw)
+	// object files only name the commands an app calls as functions, apps calling through vgen_vulkan_api must be scanned from source
+	std::set<std::string> find_referenced_commands(std::string_view text, const command_map &commands);
+
+	// adds the aliases of every referenced command and the commands the loader itself needs
+	std::set<std::string> get_command_closure(const std::set<std::string> &referenced, const command_map &commands);
+
+	std::vector<feature_data> filter_feature_commands(const std::vector<feature_data> &features, const std::set<std::string> &keep);
+	extension_map filter_extension_commands(const extension_map &extensions, const std::set<std::string> &keep);
 }
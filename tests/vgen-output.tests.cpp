@@ -1,6 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include <vgen.hpp>
 
+#include <algorithm>
 #include <string_view>
 
 using namespace std::string_literals;
@@ -50,7 +51,7 @@ TEST_CASE("write_command_definition", "[command][writer]")
 static PFN_test_void pfn_test_void;
 VKAPI_ATTR void test_void(Foo foo, Bar bar)
 {
-	assert(pfn_test_void);
+	VKLG_ASSERT_MACRO(pfn_test_void);
 	pfn_test_void(foo, bar);
 }
 )");
@@ -62,7 +63,7 @@ VKAPI_ATTR void test_void(Foo foo, Bar bar)
 static PFN_test_int pfn_test_int;
 VKAPI_ATTR int test_int(Foo foo, Bar bar)
 {
-	assert(pfn_test_int);
+	VKLG_ASSERT_MACRO(pfn_test_int);
 	return pfn_test_int(foo, bar);
 }
 )");
@@ -129,14 +130,14 @@ TEST_CASE("write_feature_definitions", "[feature][writer]")
 static PFN_test_void pfn_test_void;
 VKAPI_ATTR void test_void(Foo foo, Bar bar)
 {
-	assert(pfn_test_void);
+	VKLG_ASSERT_MACRO(pfn_test_void);
 	pfn_test_void(foo, bar);
 }
 
 static PFN_test_int pfn_test_int;
 VKAPI_ATTR int test_int(Foo foo, Bar bar)
 {
-	assert(pfn_test_int);
+	VKLG_ASSERT_MACRO(pfn_test_int);
 	return pfn_test_int(foo, bar);
 }
 
@@ -195,14 +196,14 @@ TEST_CASE("write_extension_definitions", "[extension][writer]")
 static PFN_test_void pfn_test_void;
 VKAPI_ATTR void test_void(Foo foo, Bar bar)
 {
-	assert(pfn_test_void);
+	VKLG_ASSERT_MACRO(pfn_test_void);
 	pfn_test_void(foo, bar);
 }
 
 static PFN_test_int pfn_test_int;
 VKAPI_ATTR int test_int(Foo foo, Bar bar)
 {
-	assert(pfn_test_int);
+	VKLG_ASSERT_MACRO(pfn_test_int);
 	return pfn_test_int(foo, bar);
 }
 #endif // defined(feature_foo)
@@ -228,14 +229,14 @@ VKAPI_ATTR int test_int(Foo foo, Bar bar)
 static PFN_test_void pfn_test_void;
 VKAPI_ATTR void test_void(Foo foo, Bar bar)
 {
-	assert(pfn_test_void);
+	VKLG_ASSERT_MACRO(pfn_test_void);
 	pfn_test_void(foo, bar);
 }
 
 static PFN_test_int pfn_test_int;
 VKAPI_ATTR int test_int(Foo foo, Bar bar)
 {
-	assert(pfn_test_int);
+	VKLG_ASSERT_MACRO(pfn_test_int);
 	return pfn_test_int(foo, bar);
 }
 #endif // defined(feature_bar) || defined(feature_foo)
@@ -260,7 +261,7 @@ VKAPI_ATTR int test_int(Foo foo, Bar bar)
 static PFN_test_int pfn_test_int;
 VKAPI_ATTR int test_int(Foo foo, Bar bar)
 {
-	assert(pfn_test_int);
+	VKLG_ASSERT_MACRO(pfn_test_int);
 	return pfn_test_int(foo, bar);
 }
 #endif // defined(feature_bar)
@@ -270,7 +271,7 @@ VKAPI_ATTR int test_int(Foo foo, Bar bar)
 static PFN_test_void pfn_test_void;
 VKAPI_ATTR void test_void(Foo foo, Bar bar)
 {
-	assert(pfn_test_void);
+	VKLG_ASSERT_MACRO(pfn_test_void);
 	pfn_test_void(foo, bar);
 }
 #endif // defined(feature_foo)
@@ -495,6 +496,72 @@ TEST_CASE("write_struct_extension_fields", "[struct][writer]")
 
 TEST_CASE("write feature pointer init impl", "[writer]")
 {
+	// clang-format off
+	const auto commands = std::unordered_map<std::string, vgen::command_data>
+	{
+		{
+			"fn_one"s, vgen::command_data
+			{
+				.name = "fn_one",
+				.prototype = "void fn_one",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			},
+		},
+		{
+			"fn_two"s, vgen::command_data
+			{
+				.name = "fn_two",
+				.prototype = "void fn_two",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			},
+		},
+		{
+			"vkCreateInstance"s, vgen::command_data
+			{
+				.name = "vkCreateInstance",
+				.prototype = "VkResult vkCreateInstance",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+		{
+			"vkEnumerateInstanceExtensionProperties"s, vgen::command_data
+			{
+				.name = "vkEnumerateInstanceExtensionProperties",
+				.prototype = "VkResult vkEnumerateInstanceExtensionProperties",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+		{
+			"vkEnumerateInstanceLayerProperties"s, vgen::command_data
+			{
+				.name = "vkEnumerateInstanceLayerProperties",
+				.prototype = "VkResult vkEnumerateInstanceLayerProperties",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+	};
+	// clang-format on
+
 	auto section = vgen::section_data{
 		.comment = "// section comment\n",
 		.commands = {"fn_one"s, "fn_two"s},
@@ -509,7 +576,7 @@ TEST_CASE("write feature pointer init impl", "[writer]")
 	SECTION("instance")
 	{
 		fmt::memory_buffer out;
-		write_feature_instance_init(out, feature);
+		vgen::write_block_init(out, vgen::make_feature_block(feature, commands), vgen::init_target::instance);
 
 		REQUIRE(to_string(out) == R"(
 #if defined(test_feature)
@@ -535,13 +602,38 @@ TEST_CASE("write feature pointer init impl", "[writer]")
 		};
 
 		fmt::memory_buffer out;
-		write_feature_instance_init(out, feature2);
+		vgen::write_block_init(out, vgen::make_feature_block(feature2, commands), vgen::init_target::instance);
 
 		REQUIRE(to_string(out) == R"(
 #if defined(test_feature)
 
 	pfn_fn_one = (PFN_fn_one)vkGetInstanceProcAddr(instance, "fn_one");
 
+#endif // defined(test_feature)
+)");
+	}
+
+	SECTION("skip global functions in the device init")
+	{
+		auto section2 = vgen::section_data{
+			.comment = "// section comment\n",
+			.commands = {"vkCreateInstance"s, "vkEnumerateInstanceExtensionProperties"s, "vkEnumerateInstanceLayerProperties"s, "fn_one"},
+		};
+
+		auto feature2 = vgen::feature_data{
+			.name = "test_feature",
+			.comment = "// test feature comment\n",
+			.sections = {section2},
+		};
+
+		fmt::memory_buffer out;
+		vgen::write_block_init(out, vgen::make_feature_block(feature2, commands), vgen::init_target::device);
+
+		REQUIRE(to_string(out) == R"(
+#if defined(test_feature)
+
+	pfn_fn_one = (PFN_fn_one)vkGetDeviceProcAddr(device, "fn_one");
+
 #endif // defined(test_feature)
 )");
 	}
@@ -549,7 +641,7 @@ TEST_CASE("write feature pointer init impl", "[writer]")
 	SECTION("device")
 	{
 		fmt::memory_buffer out;
-		write_feature_device_init(out, feature);
+		vgen::write_block_init(out, vgen::make_feature_block(feature, commands), vgen::init_target::device);
 
 		REQUIRE(to_string(out) == R"(
 #if defined(test_feature)
@@ -564,6 +656,36 @@ TEST_CASE("write feature pointer init impl", "[writer]")
 
 TEST_CASE("write extension pointer init impl", "[writer]")
 {
+	// clang-format off
+	const auto commands = std::unordered_map<std::string, vgen::command_data>
+	{
+		{
+			"test_void"s, vgen::command_data
+			{
+				.name = "test_void",
+				.prototype = "void test_void",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			},
+		},
+		{
+			"test_int"s, vgen::command_data
+			{
+				.name = "test_int",
+				.prototype = "int test_int",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+	};
+	// clang-format on
+
 	SECTION("Instance init")
 	{
 		SECTION("one feature, multiple commands")
@@ -577,7 +699,8 @@ TEST_CASE("write extension pointer init impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_instance_init(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_block_init(out, block, vgen::init_target::instance);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_foo)
 	pfn_test_void = (PFN_test_void)vkGetInstanceProcAddr(instance, "test_void");
@@ -597,7 +720,8 @@ TEST_CASE("write extension pointer init impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_instance_init(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_block_init(out, block, vgen::init_target::instance);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar) || defined(feature_foo)
 	pfn_test_void = (PFN_test_void)vkGetInstanceProcAddr(instance, "test_void");
@@ -617,7 +741,8 @@ TEST_CASE("write extension pointer init impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_instance_init(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_block_init(out, block, vgen::init_target::instance);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar)
 	pfn_test_int = (PFN_test_int)vkGetInstanceProcAddr(instance, "test_int");
@@ -642,7 +767,8 @@ TEST_CASE("write extension pointer init impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_device_init(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_block_init(out, block, vgen::init_target::device);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_foo)
 	pfn_test_void = (PFN_test_void)vkGetDeviceProcAddr(device, "test_void");
@@ -662,7 +788,8 @@ TEST_CASE("write extension pointer init impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_device_init(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_block_init(out, block, vgen::init_target::device);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar) || defined(feature_foo)
 	pfn_test_void = (PFN_test_void)vkGetDeviceProcAddr(device, "test_void");
@@ -682,7 +809,8 @@ TEST_CASE("write extension pointer init impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_device_init(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_block_init(out, block, vgen::init_target::device);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar)
 	pfn_test_int = (PFN_test_int)vkGetDeviceProcAddr(device, "test_int");
@@ -697,6 +825,72 @@ TEST_CASE("write extension pointer init impl", "[writer]")
 
 TEST_CASE("write feature pointer init struct impl", "[writer]")
 {
+	// clang-format off
+	const auto commands = std::unordered_map<std::string, vgen::command_data>
+	{
+		{
+			"fn_one"s, vgen::command_data
+			{
+				.name = "fn_one",
+				.prototype = "void fn_one",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			},
+		},
+		{
+			"fn_two"s, vgen::command_data
+			{
+				.name = "fn_two",
+				.prototype = "void fn_two",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			},
+		},
+		{
+			"vkCreateInstance"s, vgen::command_data
+			{
+				.name = "vkCreateInstance",
+				.prototype = "VkResult vkCreateInstance",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+		{
+			"vkEnumerateInstanceExtensionProperties"s, vgen::command_data
+			{
+				.name = "vkEnumerateInstanceExtensionProperties",
+				.prototype = "VkResult vkEnumerateInstanceExtensionProperties",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+		{
+			"vkEnumerateInstanceLayerProperties"s, vgen::command_data
+			{
+				.name = "vkEnumerateInstanceLayerProperties",
+				.prototype = "VkResult vkEnumerateInstanceLayerProperties",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+	};
+	// clang-format on
+
 	auto section = vgen::section_data{
 		.comment = "// section comment\n",
 		.commands = {"fn_one"s, "fn_two"s},
@@ -711,7 +905,7 @@ TEST_CASE("write feature pointer init struct impl", "[writer]")
 	SECTION("instance")
 	{
 		fmt::memory_buffer out;
-		write_feature_instance_init_struct(out, feature);
+		vgen::write_struct_block_init(out, vgen::make_feature_block(feature, commands), vgen::init_target::instance);
 
 		REQUIRE(to_string(out) == R"(
 #if defined(test_feature)
@@ -737,7 +931,7 @@ TEST_CASE("write feature pointer init struct impl", "[writer]")
 		};
 
 		fmt::memory_buffer out;
-		write_feature_instance_init_struct(out, feature2);
+		vgen::write_struct_block_init(out, vgen::make_feature_block(feature2, commands), vgen::init_target::instance);
 
 		REQUIRE(to_string(out) == R"(
 #if defined(test_feature)
@@ -751,7 +945,7 @@ TEST_CASE("write feature pointer init struct impl", "[writer]")
 	SECTION("device")
 	{
 		fmt::memory_buffer out;
-		write_feature_device_init_struct(out, feature);
+		vgen::write_struct_block_init(out, vgen::make_feature_block(feature, commands), vgen::init_target::device);
 
 		REQUIRE(to_string(out) == R"(
 #if defined(test_feature)
@@ -766,6 +960,36 @@ TEST_CASE("write feature pointer init struct impl", "[writer]")
 
 TEST_CASE("write extension pointer init struct impl", "[writer]")
 {
+	// clang-format off
+	const auto commands = std::unordered_map<std::string, vgen::command_data>
+	{
+		{
+			"test_void"s, vgen::command_data
+			{
+				.name = "test_void",
+				.prototype = "void test_void",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			},
+		},
+		{
+			"test_int"s, vgen::command_data
+			{
+				.name = "test_int",
+				.prototype = "int test_int",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+	};
+	// clang-format on
+
 	SECTION("Instance init")
 	{
 		SECTION("one feature, multiple commands")
@@ -779,7 +1003,8 @@ TEST_CASE("write extension pointer init struct impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_instance_init_struct(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_struct_block_init(out, block, vgen::init_target::instance);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_foo)
 	vk->test_void = (PFN_test_void)vk->vkGetInstanceProcAddr(instance, "test_void");
@@ -799,7 +1024,8 @@ TEST_CASE("write extension pointer init struct impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_instance_init_struct(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_struct_block_init(out, block, vgen::init_target::instance);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar) || defined(feature_foo)
 	vk->test_void = (PFN_test_void)vk->vkGetInstanceProcAddr(instance, "test_void");
@@ -819,7 +1045,8 @@ TEST_CASE("write extension pointer init struct impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_instance_init_struct(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_struct_block_init(out, block, vgen::init_target::instance);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar)
 	vk->test_int = (PFN_test_int)vk->vkGetInstanceProcAddr(instance, "test_int");
@@ -844,7 +1071,8 @@ TEST_CASE("write extension pointer init struct impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_device_init_struct(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_struct_block_init(out, block, vgen::init_target::device);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_foo)
 	vk->test_void = (PFN_test_void)vk->vkGetDeviceProcAddr(device, "test_void");
@@ -864,7 +1092,8 @@ TEST_CASE("write extension pointer init struct impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_device_init_struct(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_struct_block_init(out, block, vgen::init_target::device);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar) || defined(feature_foo)
 	vk->test_void = (PFN_test_void)vk->vkGetDeviceProcAddr(device, "test_void");
@@ -884,7 +1113,8 @@ TEST_CASE("write extension pointer init struct impl", "[writer]")
 			// clang-format on
 
 			fmt::memory_buffer out;
-			vgen::write_extensions_device_init_struct(out, defs);
+			for (const auto &block : vgen::make_extension_blocks(defs, commands))
+				vgen::write_struct_block_init(out, block, vgen::init_target::device);
 
 			REQUIRE(to_string(out) == R"(#if defined(feature_bar)
 	vk->test_int = (PFN_test_int)vk->vkGetDeviceProcAddr(device, "test_int");
@@ -929,7 +1159,7 @@ TEST_CASE("Filter non-device commands")
 	};
 	// clang-format on
 
-	SECTION("get_device_features")
+	SECTION("get_device_blocks features")
 	{
 		auto sections = std::vector{
 			vgen::section_data{
@@ -944,12 +1174,12 @@ TEST_CASE("Filter non-device commands")
 			.sections = sections,
 		}};
 
-		auto device_features = get_device_features(features, commands);
-		REQUIRE(device_features.at(0).sections.at(0).commands.size() == 1);
-		REQUIRE(device_features.at(0).sections.at(0).commands.at(0) == "test_int");
+		auto device_blocks = vgen::get_device_blocks({vgen::make_feature_block(features.at(0), commands)});
+		REQUIRE(device_blocks.at(0).sections.at(0).commands.size() == 1);
+		REQUIRE(device_blocks.at(0).sections.at(0).commands.at(0)->name == "test_int");
 	}
 
-	SECTION("get_device_features filters empty sections")
+	SECTION("get_device_blocks filters empty sections")
 	{
 		auto sections = std::vector{
 			vgen::section_data{
@@ -968,13 +1198,13 @@ TEST_CASE("Filter non-device commands")
 			.sections = sections,
 		}};
 
-		auto device_features = get_device_features(features, commands);
-		REQUIRE(device_features.at(0).sections.size() == 1);
-		REQUIRE(device_features.at(0).sections.at(0).commands.size() == 1);
-		REQUIRE(device_features.at(0).sections.at(0).commands.at(0) == "test_int");
+		auto device_blocks = vgen::get_device_blocks({vgen::make_feature_block(features.at(0), commands)});
+		REQUIRE(device_blocks.at(0).sections.size() == 1);
+		REQUIRE(device_blocks.at(0).sections.at(0).commands.size() == 1);
+		REQUIRE(device_blocks.at(0).sections.at(0).commands.at(0)->name == "test_int");
 	}
 
-	SECTION("get_device_features filters empty features")
+	SECTION("get_device_blocks filters empty features")
 	{
 		auto sections = std::vector{
 			vgen::section_data{
@@ -989,32 +1219,2093 @@ TEST_CASE("Filter non-device commands")
 			.sections = sections,
 		}};
 
-		auto device_features = get_device_features(features, commands);
-		REQUIRE(device_features.size() == 0);
+		auto device_blocks = vgen::get_device_blocks({vgen::make_feature_block(features.at(0), commands)});
+		REQUIRE(device_blocks.size() == 0);
 	}
 
-	SECTION("get_device_extensions")
+	SECTION("get_device_blocks extensions")
 	{
 		auto extensions = vgen::extension_map{
 			{std::set{"extension1"s}, "test_void"},
 			{std::set{"extension1"s}, "test_int"},
 		};
 
-		auto device_extensions = get_device_extensions(extensions, commands);
+		auto device_blocks = vgen::get_device_blocks(vgen::make_extension_blocks(extensions, commands));
 
-		REQUIRE(device_extensions.count(std::set{"extension1"s}) == 1);
-		REQUIRE(device_extensions.lower_bound(std::set{"extension1"s})->second == "test_int");
+		REQUIRE(device_blocks.size() == 1);
+		REQUIRE(device_blocks.at(0).condition == "extension1");
+		REQUIRE(device_blocks.at(0).sections.at(0).commands.size() == 1);
+		REQUIRE(device_blocks.at(0).sections.at(0).commands.at(0)->name == "test_int");
 	}
 
-	SECTION("get_device_extensions 2")
+	SECTION("get_device_blocks filters empty extension groups")
 	{
 		auto extensions = vgen::extension_map{
 			{std::set{"extension1"s}, "test_void"},
 		};
 
-		auto device_extensions = get_device_extensions(extensions, commands);
+		auto device_blocks = vgen::get_device_blocks(vgen::make_extension_blocks(extensions, commands));
+
+		REQUIRE(device_blocks.empty());
+	}
+}
+
+TEST_CASE("emission plan", "[plan]")
+{
+	// clang-format off
+	const auto commands = std::unordered_map<std::string, vgen::command_data>
+	{
+		{
+			"test_void"s, vgen::command_data
+			{
+				.name = "test_void",
+				.prototype = "void test_void",
+				.params = "Foo foo, Bar bar",
+				.param_names = "foo, bar",
+				.comment = "// comment\n",
+				.returns_void = true,
+				.is_device_command = false,
+			},
+		},
+		{
+			"test_int"s, vgen::command_data
+			{
+				.name = "test_int",
+				.prototype = "int test_int",
+				.params = "Foo foo, Bar bar",
+				.param_names = "foo, bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			},
+		},
+	};
+
+	auto features = std::vector
+	{
+		vgen::feature_data
+		{
+			.name = "test_feature",
+			.comment = "// test feature comment\n",
+			.sections =
+			{
+				{ .comment = "// section one\n", .commands = {"test_void"s} },
+				{ .comment = "// section two\n", .commands = {"test_int"s} },
+			},
+		},
+	};
+
+	auto extensions = vgen::extension_map
+	{
+		{ {"defined(feature_foo)"s, "defined(feature_bar)"s}, "test_void" },
+		{ {"defined(feature_foo)"s, "defined(feature_bar)"s}, "test_int" },
+	};
+	// clang-format on
+
+	auto plan = vgen::build_emission_plan("42"sv, features, extensions, commands);
+
+	SECTION("features precede extension groups")
+	{
+		REQUIRE(plan.vulkan_header_version == "42");
+		REQUIRE(plan.blocks.size() == 2);
+
+		REQUIRE(plan.blocks[0].kind == vgen::block_kind::feature);
+		REQUIRE(plan.blocks[0].name == "test_feature");
+		REQUIRE(plan.blocks[0].condition == "defined(test_feature)");
+		REQUIRE(plan.blocks[0].sections.size() == 2);
+		REQUIRE(plan.blocks[0].sections[0].commands.at(0) == &commands.at("test_void"));
+
+		REQUIRE(plan.blocks[1].kind == vgen::block_kind::extension);
+		REQUIRE(plan.blocks[1].condition == "defined(feature_bar) || defined(feature_foo)");
+		REQUIRE(plan.blocks[1].sections.size() == 1);
+		REQUIRE(plan.blocks[1].sections[0].commands.size() == 2);
+	}
+
+	SECTION("device blocks only hold device commands")
+	{
+		REQUIRE(plan.device_blocks.size() == 2);
+		REQUIRE(plan.device_blocks[0].sections.size() == 1);
+		REQUIRE(plan.device_blocks[0].sections[0].comment == "// section two\n");
+		REQUIRE(plan.device_blocks[1].sections[0].commands == std::vector{&commands.at("test_int")});
+	}
+
+	SECTION("block writers match the model writers")
+	{
+		fmt::memory_buffer from_model;
+		vgen::write_feature_definitions(from_model, features[0], commands);
+		vgen::write_extension_definitions(from_model, extensions, commands);
+
+		fmt::memory_buffer from_plan;
+		for (const auto &block : plan.blocks)
+			vgen::write_block_definitions(from_plan, block);
+
+		REQUIRE(to_string(from_plan) == to_string(from_model));
+	}
+
+	SECTION("concurrent backends match the sequential writers")
+	{
+		fmt::memory_buffer source;
+		vgen::write_source(source, "42"sv, features, extensions, commands);
+
+		auto files = vgen::generate_loader(plan);
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[0].name == "vulkan_loader.h");
+		REQUIRE(files[0].contents.find("\tPFN_test_int test_int;\n") != std::string::npos);
+		REQUIRE(files[1].name == "vulkan_loader.c");
+		REQUIRE(files[1].contents == to_string(source));
+	}
+}
+
+TEST_CASE("sharded source", "[plan][shards]")
+{
+	vgen::command_map commands;
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "// section comment\n"}},
+	};
+
+	for (int i = 0; i < 8; ++i)
+	{
+		auto name = fmt::format("test_fn{0}", i);
+		feature.sections[0].commands.emplace_back(name);
+		commands.emplace(name,
+			vgen::command_data{
+				.name = name,
+				.prototype = "void " + name,
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = i % 2 == 0,
+			});
+	}
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, vgen::extension_map{}, commands);
+
+	SECTION("split_emission_plan keeps every command exactly once, in order")
+	{
+		auto shards = vgen::split_emission_plan(plan, 3);
+		REQUIRE(shards.size() == 3);
+
+		std::vector<const vgen::command_data *> seen;
+		for (const auto &shard : shards)
+		{
+			// the commands are equally sized, so each shard gets a fair share
+			REQUIRE(shard.blocks.size() == 1);
+			REQUIRE(shard.blocks[0].condition == "defined(test_feature)");
+			REQUIRE(shard.blocks[0].sections.size() == 1);
+			REQUIRE(shard.blocks[0].sections[0].comment == "// section comment\n");
+			REQUIRE(shard.blocks[0].sections[0].commands.size() >= 2);
+
+			for (const auto *command : shard.blocks[0].sections[0].commands)
+				seen.emplace_back(command);
+		}
+
+		REQUIRE(seen == plan.blocks[0].sections[0].commands);
+	}
+
+	SECTION("more shards than commands leaves some shards empty")
+	{
+		auto shards = vgen::split_emission_plan(plan, 20);
+		REQUIRE(shards.size() == 20);
+		REQUIRE(std::count_if(begin(shards), end(shards), [](const auto &shard) { return shard.blocks.empty(); }) == 12);
+	}
+
+	SECTION("zero shards is an error")
+	{
+		REQUIRE_THROWS(vgen::split_emission_plan(plan, 0));
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.shards = 2});
+
+		std::vector<std::string> names;
+		for (const auto &file : files)
+			names.emplace_back(file.name);
+
+		REQUIRE(names == std::vector{"vulkan_loader.h"s, "vulkan_loader_shards.h"s, "vulkan_loader.c"s, "vulkan_loader_shard0.c"s, "vulkan_loader_shard1.c"s});
+
+		const auto &shards_header = files[1].contents;
+		REQUIRE(shards_header.find("extern PFN_test_fn0 pfn_test_fn0;\n") != std::string::npos);
+		REQUIRE(shards_header.find("void vgen_load_device_procs_shard1(VkDevice device, struct vgen_vulkan_api *vk);\n") != std::string::npos);
+
+		const auto &source = files[2].contents;
+		REQUIRE(source.find(R"(void vgen_load_instance_procs(VkInstance instance)
+{
+	vgen_load_instance_procs_shard0(instance);
+	vgen_load_instance_procs_shard1(instance);
+}
+)") != std::string::npos);
 
-		REQUIRE(device_extensions.empty());
-		REQUIRE(device_extensions.count(std::set{"extension1"s}) == 0);
+		const auto &shard0 = files[3].contents;
+		REQUIRE(shard0.starts_with("#include <vulkan_loader_shards.h>\n"));
+		REQUIRE(shard0.find("\nPFN_test_fn0 pfn_test_fn0;\n") != std::string::npos);
+		REQUIRE(shard0.find("static PFN_") == std::string::npos);
+		REQUIRE(shard0.find("pfn_test_fn7;") == std::string::npos);
+	}
+}
+
+TEST_CASE("split headers", "[plan][headers]")
+{
+	vgen::command_map commands;
+	auto add_command = [&](const std::string &name) {
+		commands.emplace(name,
+			vgen::command_data{
+				.name = name,
+				.prototype = "void " + name,
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = false,
+			});
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+	add_command("test_fn");
+
+	vgen::extension_map extensions;
+	for (auto [requirements, name] : {
+			 std::pair{std::set{"defined(ext_b)"s}, "ext_b_fn"s},
+			 std::pair{std::set{"defined(ext_a) && defined(ext_c)"s}, "ext_ac_fn"s},
+			 std::pair{std::set{"defined(ext_a)"s}, "ext_a_fn"s},
+		 })
+	{
+		extensions.emplace(requirements, name);
+		add_command(name);
+	}
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("requirement_names")
+	{
+		REQUIRE(vgen::requirement_names("defined(ext_a)") == std::vector{"ext_a"s});
+		REQUIRE(vgen::requirement_names("defined(ext_a) && defined(ext_c)") == std::vector{"ext_a"s, "ext_c"s});
+		REQUIRE(vgen::requirement_names("1").empty());
+		REQUIRE_THROWS(vgen::requirement_names("defined(ext_a"));
+	}
+
+	SECTION("features first, then extension groups filed under their first extension")
+	{
+		auto units = vgen::get_header_units(plan);
+		REQUIRE(units.size() == 3);
+
+		REQUIRE(units[0].name == "test_feature");
+		REQUIRE(units[0].guard == "defined(test_feature)");
+		REQUIRE(vgen::unit_header_name(units[0]) == "vulkan_loader_test_feature.h");
+
+		REQUIRE(units[1].name == "ext_a");
+		REQUIRE(units[1].blocks.size() == 2);
+		REQUIRE(units[1].guard == "(defined(ext_a)) || (defined(ext_a) && defined(ext_c))");
+
+		REQUIRE(units[2].name == "ext_b");
+		REQUIRE(units[2].guard == "defined(ext_b)");
+	}
+
+	SECTION("unit header")
+	{
+		auto units = vgen::get_header_units(plan);
+
+		fmt::memory_buffer out;
+		vgen::write_unit_header(out, units[2]);
+
+		REQUIRE(to_string(out) == R"(#if !defined(VGEN_VULKAN_LOADER_ext_b_HEADER)
+#define VGEN_VULKAN_LOADER_ext_b_HEADER
+
+#include <vulkan_loader.h>
+
+#if defined(VK_NO_PROTOTYPES) && (defined(ext_b))
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+struct vgen_ext_b
+{
+#if defined(ext_b)
+	PFN_ext_b_fn ext_b_fn;
+#endif // defined(ext_b)
+};
+
+const struct vgen_ext_b *vgen_get_ext_b(const struct vgen_vulkan_api *vk);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
+
+#endif // defined(VK_NO_PROTOTYPES) && (defined(ext_b))
+
+#endif // !defined(VGEN_VULKAN_LOADER_ext_b_HEADER)
+)");
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.split_headers = true});
+
+		std::vector<std::string> names;
+		for (const auto &file : files)
+			names.emplace_back(file.name);
+
+		REQUIRE(names == std::vector{"vulkan_loader.h"s, "vulkan_loader_test_feature.h"s, "vulkan_loader_ext_a.h"s, "vulkan_loader_ext_b.h"s, "vulkan_loader.c"s});
+
+		// the core header only carries an opaque table
+		const auto &header = files[0].contents;
+		REQUIRE(header.find("struct vgen_vulkan_api;\n") != std::string::npos);
+		REQUIRE(header.find("PFN_test_fn") == std::string::npos);
+
+		const auto &source = files[4].contents;
+		REQUIRE(source.find("#include <vulkan_loader_ext_a.h>\n") != std::string::npos);
+		REQUIRE(source.find("\tstruct vgen_ext_a ext_a_api;\n") != std::string::npos);
+		REQUIRE(source.find("\tvk->ext_b_api.ext_b_fn = (PFN_ext_b_fn)vk->vkGetInstanceProcAddr(instance, \"ext_b_fn\");\n") != std::string::npos);
+	}
+}
+
+TEST_CASE("C++ module", "[plan][module]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, vgen::extension_map{}, commands);
+
+	SECTION("interface exports the struct and load functions")
+	{
+		fmt::memory_buffer out;
+		vgen::write_module_interface(out, plan);
+		auto interface = to_string(out);
+
+		REQUIRE(interface.find("\nmodule;\n") != std::string::npos);
+		REQUIRE(interface.find("\nexport module vulkan_loader;\n") != std::string::npos);
+		REQUIRE(interface.find(R"(
+export struct vgen_vulkan_api
+{
+#if defined(test_feature)
+
+
+	PFN_test_fn test_fn;
+
+#endif // defined(test_feature)
+};
+)") != std::string::npos);
+		REQUIRE(interface.find("export void vgen_load_device_procs(VkDevice device, struct vgen_vulkan_api *vk);\n") != std::string::npos);
+	}
+
+	SECTION("implementation unit")
+	{
+		fmt::memory_buffer out;
+		vgen::write_module_implementation(out, plan);
+		auto implementation = to_string(out);
+
+		REQUIRE(implementation.starts_with("module;\n"));
+		REQUIRE(implementation.find("\nmodule vulkan_loader;\n") != std::string::npos);
+		REQUIRE(implementation.find("\tvk->test_fn = (PFN_test_fn)vk->vkGetDeviceProcAddr(device, \"test_fn\");\n") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.cpp_module = true});
+
+		std::vector<std::string> names;
+		for (const auto &file : files)
+			names.emplace_back(file.name);
+
+		REQUIRE(names == std::vector{"vulkan_loader.h"s, "vulkan_loader.c"s, "vulkan_loader.cppm"s, "vulkan_loader_module.cpp"s});
+	}
+}
+
+TEST_CASE("loader variants", "[plan][variants]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, vgen::extension_map{}, commands);
+
+	SECTION("prototypes only")
+	{
+		fmt::memory_buffer header;
+		vgen::write_header(header, plan, vgen::loader_variant::prototypes);
+		REQUIRE(to_string(header).find("struct vgen_vulkan_api") == std::string::npos);
+		REQUIRE(to_string(header).find("\n#else // !defined(VK_NO_PROTOTYPES)\n\n#error ") != std::string::npos);
+
+		fmt::memory_buffer source;
+		vgen::write_source(source, plan, {}, vgen::loader_variant::prototypes);
+		REQUIRE(to_string(source).find("static PFN_test_fn pfn_test_fn;\n") != std::string::npos);
+		REQUIRE(to_string(source).find("vk->") == std::string::npos);
+		REQUIRE(to_string(source).find("#if defined(VK_NO_PROTOTYPES)") == std::string::npos);
+	}
+
+	SECTION("struct only")
+	{
+		fmt::memory_buffer header;
+		vgen::write_header(header, plan, vgen::loader_variant::api_struct);
+		REQUIRE(to_string(header).find("void vgen_load_device_procs(VkDevice device);") == std::string::npos);
+		REQUIRE(to_string(header).find("\n#if !defined(VK_NO_PROTOTYPES)\n\n#error ") != std::string::npos);
+		REQUIRE(to_string(header).find("\tPFN_test_fn test_fn;\n") != std::string::npos);
+
+		fmt::memory_buffer source;
+		vgen::write_source(source, plan, {}, vgen::loader_variant::api_struct);
+		REQUIRE(to_string(source).find("pfn_test_fn") == std::string::npos);
+		REQUIRE(to_string(source).find("\tvk->test_fn = (PFN_test_fn)vk->vkGetDeviceProcAddr(device, \"test_fn\");\n") != std::string::npos);
+	}
+
+	SECTION("separate file sets")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .separate_variants = true});
+
+		std::vector<std::string> names;
+		for (const auto &file : files)
+			names.emplace_back(file.name);
+
+		REQUIRE(names == std::vector{
+							 "prototypes/vulkan_loader.h"s,
+							 "prototypes/vulkan_loader_shards.h"s,
+							 "prototypes/vulkan_loader.c"s,
+							 "prototypes/vulkan_loader_shard0.c"s,
+							 "prototypes/vulkan_loader_shard1.c"s,
+							 "struct/vulkan_loader.h"s,
+							 "struct/vulkan_loader_shards.h"s,
+							 "struct/vulkan_loader.c"s,
+							 "struct/vulkan_loader_shard0.c"s,
+							 "struct/vulkan_loader_shard1.c"s,
+						 });
+
+		REQUIRE(files[3].contents.find("vk->") == std::string::npos);
+		REQUIRE(files[8].contents.find("pfn_") == std::string::npos);
+	}
+}
+
+TEST_CASE("table init", "[plan][table]")
+{
+	vgen::command_map commands{
+		// the global functions, which the parser counts as device level
+		{"vkCreateInstance"s,
+			vgen::command_data{
+				.name = "vkCreateInstance",
+				.prototype = "VkResult vkCreateInstance",
+				.params = "const VkInstanceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkInstance* pInstance",
+				.param_names = "pCreateInfo, pAllocator, pInstance",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"vkEnumerateInstanceExtensionProperties"s,
+			vgen::command_data{
+				.name = "vkEnumerateInstanceExtensionProperties",
+				.prototype = "VkResult vkEnumerateInstanceExtensionProperties",
+				.params = "const char* pLayerName, uint32_t* pPropertyCount, VkExtensionProperties* pProperties",
+				.param_names = "pLayerName, pPropertyCount, pProperties",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"vkEnumerateInstanceLayerProperties"s,
+			vgen::command_data{
+				.name = "vkEnumerateInstanceLayerProperties",
+				.prototype = "VkResult vkEnumerateInstanceLayerProperties",
+				.params = "uint32_t* pPropertyCount, VkLayerProperties* pProperties",
+				.param_names = "pPropertyCount, pProperties",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"vkGetInstanceProcAddr"s,
+			vgen::command_data{
+				.name = "vkGetInstanceProcAddr",
+				.prototype = "PFN_vkVoidFunction vkGetInstanceProcAddr",
+				.params = "VkInstance instance, const char* pName",
+				.param_names = "instance, pName",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"vkCreateInstance", "vkEnumerateInstanceExtensionProperties", "vkEnumerateInstanceLayerProperties", "vkGetInstanceProcAddr", "test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("command enum")
+	{
+		fmt::memory_buffer out;
+		vgen::write_command_enum(out, plan);
+
+		REQUIRE(to_string(out) == R"(
+// Slots of the dispatch table filled by the load functions. Commands whose guard is
+// not defined take no slot, so vgen_command_count is the size of the table.
+enum vgen_command
+{
+
+#if defined(test_feature)
+
+	vgen_command_vkCreateInstance,
+	vgen_command_vkEnumerateInstanceExtensionProperties,
+	vgen_command_vkEnumerateInstanceLayerProperties,
+	vgen_command_vkGetInstanceProcAddr,
+	vgen_command_test_fn,
+
+#endif // defined(test_feature)
+#if defined(ext_a)
+	vgen_command_ext_fn,
+#endif // defined(ext_a)
+	vgen_command_count
+};
+)");
+	}
+
+	SECTION("packed name table")
+	{
+		fmt::memory_buffer out;
+		vgen::write_command_name_table(out, plan);
+		auto table = to_string(out);
+
+		REQUIRE(table.find("\tchar test_fn[sizeof(\"test_fn\")];\n") != std::string::npos);
+		REQUIRE(table.find("#if defined(ext_a)\n\t\"ext_fn\",\n#endif // defined(ext_a)\n") != std::string::npos);
+		REQUIRE(table.find("static const uint16_t vgen_command_offsets[vgen_command_count] = {\n") != std::string::npos);
+		REQUIRE(table.find("\toffsetof(struct vgen_command_name_blob, ext_fn),\n") != std::string::npos);
+		REQUIRE(table.find(R"(// the slots vgen_load_device_procs fills
+static const uint16_t vgen_device_commands[] = {
+
+#if defined(test_feature)
+
+	vgen_command_test_fn,
+
+#endif // defined(test_feature)
+};
+)") != std::string::npos);
+	}
+
+	SECTION("wrappers call through the table")
+	{
+		fmt::memory_buffer out;
+		vgen::write_table_command_definition(out, commands.at("ext_fn"));
+
+		REQUIRE(to_string(out) == R"(
+VKAPI_ATTR int ext_fn(Bar bar)
+{
+	PFN_ext_fn pfn = (PFN_ext_fn)vgen_table[vgen_command_ext_fn];
+	VKLG_ASSERT_MACRO(pfn);
+	return pfn(bar);
+}
+)");
+	}
+
+	SECTION("load functions loop over the table")
+	{
+		fmt::memory_buffer out;
+		vgen::write_source_table_struct_loader(out, plan);
+		auto loader = to_string(out);
+
+		REQUIRE(loader.find("\tvk->vkCreateInstance = (PFN_vkCreateInstance)get_address(0, vgen_command_name(vgen_command_vkCreateInstance));\n") != std::string::npos);
+		REQUIRE(loader.find(R"(void vgen_load_device_procs(VkDevice device, struct vgen_vulkan_api *vk)
+{
+	PFN_vkGetDeviceProcAddr get_proc = vk->vkGetDeviceProcAddr;
+	for (size_t i = 0; i < sizeof(vgen_device_commands) / sizeof(vgen_device_commands[0]); ++i)
+		vgen_set_field(vk, vgen_device_commands[i], get_proc(device, vgen_command_name(vgen_device_commands[i])));
+}
+)") != std::string::npos);
+		REQUIRE(loader.find("\"test_fn\"") == std::string::npos);
+	}
+
+	SECTION("struct fields are filled through their offsets")
+	{
+		fmt::memory_buffer out;
+		vgen::write_header(out, plan, vgen::loader_variant::both, vgen::generator_options{.init = vgen::init_mode::table});
+		auto header = to_string(out);
+
+		REQUIRE(header.find("enum vgen_command\n") < header.find("#if !defined(VK_NO_PROTOTYPES)"));
+		REQUIRE(header.find("union") == std::string::npos);
+		REQUIRE(header.find("#endif // defined(ext_a)\n};\n") != std::string::npos);
+
+		fmt::memory_buffer source;
+		vgen::write_source_table_struct_loader(source, plan);
+		auto loader = to_string(source);
+
+		REQUIRE(loader.find("\nstatic const uint16_t vgen_command_fields[vgen_command_count] = {\n") != std::string::npos);
+		REQUIRE(loader.find("\toffsetof(struct vgen_vulkan_api, test_fn),\n") != std::string::npos);
+		REQUIRE(loader.find("\tmemcpy((char *)vk + vgen_command_fields[command], &pfn, sizeof(pfn));\n") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::table});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[1].contents.find("static PFN_vkVoidFunction vgen_table[vgen_command_count];\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("pfn_") == std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .init = vgen::init_mode::table}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.split_headers = true, .init = vgen::init_mode::table}));
+	}
+}
+
+TEST_CASE("lazy init", "[plan][lazy]")
+{
+	vgen::command_map commands{
+		{"vkGetInstanceProcAddr"s,
+			vgen::command_data{
+				.name = "vkGetInstanceProcAddr",
+				.prototype = "PFN_vkVoidFunction vkGetInstanceProcAddr",
+				.params = "VkInstance instance, const char* pName",
+				.param_names = "instance, pName",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"vkGetInstanceProcAddr", "test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("pointers start as trampolines")
+	{
+		fmt::memory_buffer out;
+		vgen::write_lazy_command_definition(out, commands.at("ext_fn"));
+
+		REQUIRE(to_string(out) == R"(
+static VKAPI_ATTR int VKAPI_CALL vgen_lazy_ext_fn(Bar bar);
+static PFN_ext_fn pfn_ext_fn = vgen_lazy_ext_fn;
+VKAPI_ATTR int ext_fn(Bar bar)
+{
+	return pfn_ext_fn(bar);
+}
+
+static VKAPI_ATTR int VKAPI_CALL vgen_lazy_ext_fn(Bar bar)
+{
+	pfn_ext_fn = (PFN_ext_fn)vgen_resolve_instance_command("ext_fn");
+	VKLG_ASSERT_MACRO(pfn_ext_fn);
+	return pfn_ext_fn(bar);
+}
+)");
+	}
+
+	SECTION("device commands resolve through the device")
+	{
+		fmt::memory_buffer out;
+		vgen::write_lazy_command_definition(out, commands.at("test_fn"));
+
+		REQUIRE(to_string(out).find("\tpfn_test_fn = (PFN_test_fn)vgen_resolve_device_command(\"test_fn\");\n\tVKLG_ASSERT_MACRO(pfn_test_fn);\n\tpfn_test_fn(foo);\n") != std::string::npos);
+	}
+
+	SECTION("the loader functions stay eager")
+	{
+		fmt::memory_buffer lazy;
+		vgen::write_lazy_command_definition(lazy, commands.at("vkGetInstanceProcAddr"));
+
+		fmt::memory_buffer eager;
+		vgen::write_command_definition(eager, commands.at("vkGetInstanceProcAddr"));
+
+		REQUIRE(to_string(lazy) == to_string(eager));
+	}
+
+	SECTION("load functions reset the pointers")
+	{
+		fmt::memory_buffer out;
+		vgen::write_source_lazy_prototype_loader(out, plan);
+		auto loader = to_string(out);
+
+		REQUIRE(loader.find("\tpfn_vkCreateInstance = vgen_lazy_vkCreateInstance;\n") != std::string::npos);
+		REQUIRE(loader.find(R"(void vgen_load_device_procs(VkDevice device)
+{
+	vgen_device = device;
+	pfn_vkGetDeviceProcAddr = (PFN_vkGetDeviceProcAddr)pfn_vkGetDeviceProcAddr(device, "vkGetDeviceProcAddr");
+
+#if defined(test_feature)
+
+	pfn_test_fn = vgen_lazy_test_fn;
+
+#endif // defined(test_feature)
+}
+)") != std::string::npos);
+		REQUIRE(loader.find("pfn_vkGetInstanceProcAddr = vgen_lazy_") == std::string::npos);
+		REQUIRE(loader.find("pfn_ext_fn = vgen_lazy_ext_fn;\n") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::lazy});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[1].contents.find("vk->ext_fn = (PFN_ext_fn)vk->vkGetInstanceProcAddr(instance, \"ext_fn\");\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("static PFN_ext_fn pfn_ext_fn = vgen_lazy_ext_fn;\n") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .init = vgen::init_mode::lazy}));
+	}
+}
+
+TEST_CASE("device dispatch", "[plan][dispatch]")
+{
+	vgen::command_map commands{
+		{"vkGetDeviceProcAddr"s,
+			vgen::command_data{
+				.name = "vkGetDeviceProcAddr",
+				.prototype = "PFN_vkVoidFunction vkGetDeviceProcAddr",
+				.params = "VkDevice device, const char* pName",
+				.param_names = "device, pName",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "VkQueue queue, Foo foo",
+				.param_names = "queue, foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		// the parser counts every command not taking an instance or physical device as device level
+		{"vkCreateInstance"s,
+			vgen::command_data{
+				.name = "vkCreateInstance",
+				.prototype = "VkResult vkCreateInstance",
+				.params = "const VkInstanceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkInstance* pInstance",
+				.param_names = "pCreateInfo, pAllocator, pInstance",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"vkEnumerateInstanceVersion"s,
+			vgen::command_data{
+				.name = "vkEnumerateInstanceVersion",
+				.prototype = "VkResult vkEnumerateInstanceVersion",
+				.params = "uint32_t* pApiVersion",
+				.param_names = "pApiVersion",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "VkInstance instance",
+				.param_names = "instance",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"vkCreateInstance", "vkEnumerateInstanceVersion", "vkGetDeviceProcAddr", "test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("wrappers dispatch on their first parameter")
+	{
+		fmt::memory_buffer out;
+		vgen::write_device_dispatch_command_definition(out, commands.at("test_fn"));
+
+		REQUIRE(to_string(out) == R"(
+static PFN_test_fn pfn_test_fn;
+VKAPI_ATTR void test_fn(VkQueue queue, Foo foo)
+{
+	const struct vgen_device_table *device_table = vgen_find_device(queue);
+	PFN_test_fn pfn = device_table ? device_table->test_fn : pfn_test_fn;
+	VKLG_ASSERT_MACRO(pfn);
+	pfn(queue, foo);
+}
+)");
+	}
+
+	SECTION("device table holds the device level commands")
+	{
+		fmt::memory_buffer out;
+		vgen::write_device_table(out, plan);
+		auto table = to_string(out);
+
+		REQUIRE(table.find(R"(struct vgen_device_table
+{
+	void *key;
+
+#if defined(test_feature)
+
+	PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
+	PFN_test_fn test_fn;
+
+#endif // defined(test_feature)
+};
+)") != std::string::npos);
+		REQUIRE(table.find("ext_fn") == std::string::npos);
+	}
+
+	SECTION("commands without a device handle first are not dispatched")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.device_dispatch = true});
+
+		REQUIRE(files[1].contents.find("VKAPI_ATTR VkResult vkEnumerateInstanceVersion(uint32_t* pApiVersion)\n{\n\tVKLG_ASSERT_MACRO(pfn_vkEnumerateInstanceVersion);\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("vgen_find_device(pCreateInfo)") == std::string::npos);
+		REQUIRE(files[1].contents.find("vgen_find_device(pApiVersion)") == std::string::npos);
+		REQUIRE(files[1].contents.find("device_table->vkCreateInstance") == std::string::npos);
+		REQUIRE(files[1].contents.find("device_table->vkEnumerateInstanceVersion") == std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.device_dispatch = true});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[0].contents.find("void vgen_unload_device_procs(VkDevice device);\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("\tdevice_table->test_fn = (PFN_test_fn)pfn_vkGetDeviceProcAddr(device, \"test_fn\");\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("VKAPI_ATTR int ext_fn(VkInstance instance)\n{\n\tVKLG_ASSERT_MACRO(pfn_ext_fn);\n") != std::string::npos);
+
+		// the struct variant already keeps one table per vgen_vulkan_api
+		REQUIRE(files[1].contents.find("\tvk->test_fn = (PFN_test_fn)vk->vkGetDeviceProcAddr(device, \"test_fn\");\n") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .device_dispatch = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::lazy, .device_dispatch = true}));
+	}
+}
+
+TEST_CASE("inline dispatch", "[plan][dispatch]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("header maps the prototypes to the pointers")
+	{
+		fmt::memory_buffer out;
+		vgen::write_inline_dispatch(out, plan);
+		auto header = to_string(out);
+
+		REQUIRE(header.find(R"(#if !defined(VGEN_NO_INLINE_DISPATCH)
+
+#if defined(test_feature)
+
+extern PFN_test_fn pfn_test_fn;
+#define test_fn pfn_test_fn
+
+#endif // defined(test_feature)
+#if defined(ext_a)
+extern PFN_ext_fn pfn_ext_fn;
+#define ext_fn pfn_ext_fn
+#endif // defined(ext_a)
+
+#endif // !defined(VGEN_NO_INLINE_DISPATCH)
+)") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.inline_dispatch = true});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[0].contents.find("#define ext_fn pfn_ext_fn\n") != std::string::npos);
+
+		// the source defines the wrappers under the mapped names, so it opts out before including the header
+		REQUIRE(files[1].contents.starts_with("#if !defined(VGEN_NO_INLINE_DISPATCH)\n\t#define VGEN_NO_INLINE_DISPATCH\n#endif\n#include <vulkan_loader.h>\n"));
+		REQUIRE(files[1].contents.find("\nPFN_ext_fn pfn_ext_fn;\n") != std::string::npos);
+
+		auto lazy = vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::lazy, .inline_dispatch = true});
+		REQUIRE(lazy[1].contents.find("\nPFN_ext_fn pfn_ext_fn = vgen_lazy_ext_fn;\n") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::table, .inline_dispatch = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.device_dispatch = true, .inline_dispatch = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .inline_dispatch = true}));
+	}
+}
+
+TEST_CASE("not present stubs", "[plan][stubs]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"test_result"s,
+			vgen::command_data{
+				.name = "test_result",
+				.prototype = "VkResult test_result",
+				.params = "Foo foo, Bar* pBar",
+				.param_names = "foo, pBar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn", "test_result"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("stubs return not present")
+	{
+		fmt::memory_buffer out;
+		vgen::write_not_present_stub(out, commands.at("test_result"));
+		vgen::write_not_present_stub(out, commands.at("ext_fn"));
+		vgen::write_not_present_stub(out, commands.at("test_fn"));
+
+		REQUIRE(to_string(out) == R"(static VKAPI_ATTR VkResult VKAPI_CALL vgen_missing_test_result(Foo foo, Bar* pBar)
+{
+	(void)foo;
+	(void)pBar;
+	return VGEN_NOT_PRESENT_RESULT;
+}
+static VKAPI_ATTR int VKAPI_CALL vgen_missing_ext_fn(Bar bar)
+{
+	(void)bar;
+	return 0;
+}
+static VKAPI_ATTR void VKAPI_CALL vgen_missing_test_fn(Foo foo)
+{
+	(void)foo;
+}
+)");
+	}
+
+	SECTION("wrappers call without a check")
+	{
+		fmt::memory_buffer out;
+		vgen::write_stub_command_definition(out, commands.at("ext_fn"));
+
+		REQUIRE(to_string(out).ends_with(R"(
+static PFN_ext_fn pfn_ext_fn = vgen_missing_ext_fn;
+VKAPI_ATTR int ext_fn(Bar bar)
+{
+	return pfn_ext_fn(bar);
+}
+)"));
+	}
+
+	SECTION("load functions fall back to the stubs")
+	{
+		fmt::memory_buffer out;
+		vgen::write_source_stub_prototype_loader(out, plan);
+		auto loader = to_string(out);
+
+		REQUIRE(loader.find("\tpfn_vkCreateInstance = (PFN_vkCreateInstance)vgen_loaded_or(vkGetInstanceProcAddr(0, \"vkCreateInstance\"), (PFN_vkVoidFunction)vgen_missing_vkCreateInstance);\n") != std::string::npos);
+		REQUIRE(loader.find("\tpfn_test_result = (PFN_test_result)vgen_loaded_or(vkGetDeviceProcAddr(device, \"test_result\"), (PFN_vkVoidFunction)vgen_missing_test_result);\n") != std::string::npos);
+		REQUIRE(loader.find("VKLG_ASSERT_MACRO") == std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.not_present_stubs = true});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[1].contents.find("\t#define VKLG_ASSERT_MACRO assert\n#endif\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("\t#define VGEN_NOT_PRESENT_RESULT VK_ERROR_EXTENSION_NOT_PRESENT\n") != std::string::npos);
+
+		// the struct variant keeps null pointers, which callers test to find out whether a command is available
+		REQUIRE(files[1].contents.find("\tvk->ext_fn = (PFN_ext_fn)vk->vkGetInstanceProcAddr(instance, \"ext_fn\");\n") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::lazy, .not_present_stubs = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .not_present_stubs = true}));
+	}
+}
+
+TEST_CASE("thread safe", "[plan][atomics]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("wrappers load the pointer once")
+	{
+		fmt::memory_buffer out;
+		vgen::write_atomic_command_definition(out, commands.at("ext_fn"));
+
+		REQUIRE(to_string(out) == R"(
+static _Atomic(PFN_ext_fn) pfn_ext_fn;
+VKAPI_ATTR int ext_fn(Bar bar)
+{
+	PFN_ext_fn pfn = atomic_load_explicit(&pfn_ext_fn, memory_order_relaxed);
+	VKLG_ASSERT_MACRO(pfn);
+	return pfn(bar);
+}
+)");
+	}
+
+	SECTION("load functions are guarded")
+	{
+		fmt::memory_buffer out;
+		vgen::write_source_atomic_prototype_loader(out, plan);
+		auto loader = to_string(out);
+
+		REQUIRE(loader.find("#include <stdatomic.h>\n") != std::string::npos);
+		REQUIRE(loader.find("\tatomic_store_explicit(&pfn_vkCreateInstance, (PFN_vkCreateInstance)vkGetInstanceProcAddr(0, \"vkCreateInstance\"), memory_order_relaxed);\n") != std::string::npos);
+		REQUIRE(loader.find("\tatomic_store_explicit(&pfn_test_fn, (PFN_test_fn)vkGetDeviceProcAddr(device, \"test_fn\"), memory_order_relaxed);\n") != std::string::npos);
+
+		REQUIRE(loader.ends_with(R"(
+void vgen_load_device_procs(VkDevice device)
+{
+	if (atomic_load_explicit(&vgen_loaded_device, memory_order_acquire) == device)
+		return;
+
+	vgen_lock();
+	if (atomic_load_explicit(&vgen_loaded_device, memory_order_relaxed) != device)
+	{
+		vgen_load_device_procs_locked(device);
+		atomic_store_explicit(&vgen_loaded_device, device, memory_order_release);
+	}
+	vgen_unlock();
+}
+)"));
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.thread_safe = true});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[1].contents.find("static _Atomic(PFN_test_fn) pfn_test_fn;\n") != std::string::npos);
+
+		// the struct variant belongs to its caller, who synchronizes it
+		REQUIRE(files[1].contents.find("\tvk->ext_fn = (PFN_ext_fn)vk->vkGetInstanceProcAddr(instance, \"ext_fn\");\n") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::lazy, .thread_safe = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .thread_safe = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.not_present_stubs = true, .thread_safe = true}));
+	}
+}
+
+TEST_CASE("load enabled extensions", "[plan][extensions]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"shared_fn"s,
+			vgen::command_data{
+				.name = "shared_fn",
+				.prototype = "void shared_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+		{std::set{"defined(ext_a) && defined(ext_b)"s, "defined(ext_c) && defined(VK_VERSION_1_1)"s}, "shared_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("conditions test the extensions but not the features")
+	{
+		REQUIRE(vgen::get_enabled_condition(plan.blocks[0]).empty());
+		REQUIRE(vgen::get_enabled_condition(plan.blocks[1]) == R"(vgen_extension_enabled("ext_a", extension_count, extension_names))");
+		REQUIRE(vgen::get_enabled_condition(plan.blocks[2]) == R"((vgen_extension_enabled("ext_a", extension_count, extension_names) && vgen_extension_enabled("ext_b", extension_count, extension_names)) || (vgen_extension_enabled("ext_c", extension_count, extension_names) && api_version >= VK_API_VERSION_1_1))");
+
+		auto feature_only = plan.blocks[2];
+		feature_only.requirements = {"defined(VK_VERSION_1_0)"};
+		REQUIRE(vgen::get_enabled_condition(feature_only).empty());
+	}
+
+	SECTION("versions above 1.0 test the api version")
+	{
+		auto version_plan = vgen::build_emission_plan("42"sv, std::vector{vgen::feature_data{.name = "VK_VERSION_1_2", .comment = "", .sections = feature.sections}}, extensions, commands);
+		REQUIRE(vgen::get_enabled_condition(version_plan.blocks[0]) == "api_version >= VK_API_VERSION_1_2");
+
+		auto files = vgen::generate_loader(version_plan, vgen::generator_options{.variant = vgen::loader_variant::prototypes, .load_enabled_extensions = true});
+		REQUIRE(files[1].contents.find(R"(
+#if defined(VK_VERSION_1_2)
+
+	enabled = api_version >= VK_API_VERSION_1_2;
+	pfn_test_fn = enabled ? (PFN_test_fn)vkGetDeviceProcAddr(device, "test_fn") : 0;
+
+#endif // defined(VK_VERSION_1_2)
+)") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.load_enabled_extensions = true});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[0].contents.find("void vgen_load_device_procs_ex(VkDevice device, uint32_t api_version, uint32_t extension_count, const char *const *extension_names);\n") != std::string::npos);
+		REQUIRE(files[0].contents.find("void vgen_load_device_procs_ex(VkDevice device, uint32_t api_version, uint32_t extension_count, const char *const *extension_names, struct vgen_vulkan_api *vk);\n") != std::string::npos);
+
+		REQUIRE(files[1].contents.find("static int vgen_extension_enabled(const char *name, uint32_t extension_count, const char *const *extension_names)\n") != std::string::npos);
+		REQUIRE(files[1].contents.find(R"(
+#if defined(ext_a)
+	enabled = vgen_extension_enabled("ext_a", extension_count, extension_names);
+	pfn_ext_fn = enabled ? (PFN_ext_fn)vkGetDeviceProcAddr(device, "ext_fn") : 0;
+#endif // defined(ext_a)
+)") != std::string::npos);
+		REQUIRE(files[1].contents.find("\tvk->ext_fn = enabled ? (PFN_ext_fn)vk->vkGetDeviceProcAddr(device, \"ext_fn\") : 0;\n") != std::string::npos);
+
+		// feature commands are loaded regardless
+		REQUIRE(files[1].contents.find("\tpfn_test_fn = (PFN_test_fn)vkGetDeviceProcAddr(device, \"test_fn\");\n") != std::string::npos);
+	}
+
+	SECTION("skipped commands fall back to their stubs")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.variant = vgen::loader_variant::prototypes, .not_present_stubs = true, .load_enabled_extensions = true});
+
+		REQUIRE(files[1].contents.find("\tpfn_ext_fn = enabled ? (PFN_ext_fn)vgen_loaded_or(vkGetDeviceProcAddr(device, \"ext_fn\"), (PFN_vkVoidFunction)vgen_missing_ext_fn) : vgen_missing_ext_fn;\n") != std::string::npos);
+	}
+
+	SECTION("invalid combinations")
+	{
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::table, .load_enabled_extensions = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .load_enabled_extensions = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.split_headers = true, .load_enabled_extensions = true}));
+	}
+}
+
+TEST_CASE("share alias slots", "[plan][aliases]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"test_fnKHR"s,
+			vgen::command_data{
+				.name = "test_fnKHR",
+				.prototype = "void test_fnKHR",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+				.alias_of = "test_fn",
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "test_fnKHR"s},
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("families hold the commands with aliases, promoted command first")
+	{
+		auto families = vgen::get_alias_families(plan.blocks);
+
+		REQUIRE(families.size() == 1);
+		REQUIRE(families[0].size() == 2);
+		REQUIRE(families[0][0]->name == "test_fn");
+		REQUIRE(families[0][1]->name == "test_fnKHR");
+
+		std::vector<vgen::plan_block> reversed(plan.blocks.rbegin(), plan.blocks.rend());
+		REQUIRE(vgen::get_alias_families(reversed)[0][0]->name == "test_fn");
+	}
+
+	SECTION("each family is looked up once")
+	{
+		fmt::memory_buffer out;
+		vgen::write_source_prototype_loader(out, plan, vgen::pfn_storage::file_scope, vgen::alias_loading::shared);
+		auto loader = to_string(out);
+
+		REQUIRE(loader.find(R"(
+void vgen_load_device_procs(VkDevice device)
+{
+	PFN_vkVoidFunction aliased[1];
+	(void)aliased;
+#if defined(ext_a) || defined(test_feature)
+	static const char *const vgen_alias_names_0[] = {"test_fn", "test_fnKHR", 0};
+	aliased[0] = vgen_first_device_proc(vkGetDeviceProcAddr, device, vgen_alias_names_0);
+#endif
+)") != std::string::npos);
+		REQUIRE(loader.find("\tpfn_test_fn = (PFN_test_fn)aliased[0];\n") != std::string::npos);
+		REQUIRE(loader.find("\tpfn_test_fnKHR = (PFN_test_fnKHR)aliased[0];\n") != std::string::npos);
+		REQUIRE(loader.find("\tpfn_ext_fn = (PFN_ext_fn)vkGetInstanceProcAddr(instance, \"ext_fn\");\n") != std::string::npos);
+		REQUIRE(loader.find("\"test_fnKHR\");") == std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, vgen::generator_options{.share_alias_slots = true});
+
+		REQUIRE(files.size() == 2);
+		REQUIRE(files[1].contents.find("static PFN_vkVoidFunction vgen_first_instance_proc(PFN_vkGetInstanceProcAddr get_proc, VkInstance instance, const char *const *names)\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("\taliased[0] = vgen_first_device_proc(vk->vkGetDeviceProcAddr, device, vgen_alias_names_0);\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("(const char *const[])") == std::string::npos);
+		REQUIRE(files[1].contents.find("\tvk->test_fnKHR = (PFN_test_fnKHR)aliased[0];\n") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::table, .share_alias_slots = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.shards = 2, .share_alias_slots = true}));
+	}
+}
+
+TEST_CASE("async device load", "[plan][async]")
+{
+	vgen::command_map commands{
+		{"vkGetDeviceProcAddr"s,
+			vgen::command_data{
+				.name = "vkGetDeviceProcAddr",
+				.prototype = "PFN_vkVoidFunction vkGetDeviceProcAddr",
+				.params = "VkDevice device, const char *pName",
+				.param_names = "device, pName",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		// a global function, which the parser counts as device level
+		{"vkCreateInstance"s,
+			vgen::command_data{
+				.name = "vkCreateInstance",
+				.prototype = "VkResult vkCreateInstance",
+				.params = "const VkInstanceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkInstance* pInstance",
+				.param_names = "pCreateInfo, pAllocator, pInstance",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = true,
+			}},
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"hot_fn"s,
+			vgen::command_data{
+				.name = "hot_fn",
+				.prototype = "void hot_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"vkCreateInstance", "vkGetDeviceProcAddr", "test_fn", "hot_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+	vgen::generator_options options{.async_device_load = true, .hot_commands = {"hot_fn"}};
+
+	SECTION("device wrappers wait for the background load")
+	{
+		fmt::memory_buffer out;
+		vgen::write_async_command_definition(out, commands.at("test_fn"));
+
+		REQUIRE(to_string(out) == R"(
+static PFN_test_fn pfn_test_fn;
+VKAPI_ATTR void test_fn(Foo foo)
+{
+	if (atomic_load_explicit(&vgen_device_state, memory_order_acquire) == vgen_device_loading)
+		vgen_wait_device_procs();
+	VKLG_ASSERT_MACRO(pfn_test_fn);
+	pfn_test_fn(foo);
+}
+)");
+	}
+
+	SECTION("hot commands are loaded before the thread starts")
+	{
+		fmt::memory_buffer out;
+		vgen::write_source_async_prototype_loader(out, plan, options);
+		auto loader = to_string(out);
+
+		// instance commands, global functions, hot commands and the loader functions the background load calls never wait
+		REQUIRE(loader.find("if (atomic_load_explicit(&vgen_device_state, memory_order_acquire) == vgen_device_loading)\n\t\tvgen_wait_device_procs();\n\tVKLG_ASSERT_MACRO(pfn_test_fn);\n") != std::string::npos);
+		REQUIRE(loader.find("vgen_wait_device_procs();\n\tVKLG_ASSERT_MACRO(pfn_hot_fn);\n") == std::string::npos);
+		REQUIRE(loader.find("vgen_wait_device_procs();\n\tVKLG_ASSERT_MACRO(pfn_ext_fn);\n") == std::string::npos);
+		REQUIRE(loader.find("vgen_wait_device_procs();\n\tVKLG_ASSERT_MACRO(pfn_vkGetDeviceProcAddr);\n") == std::string::npos);
+		REQUIRE(loader.find("vgen_wait_device_procs();\n\tVKLG_ASSERT_MACRO(pfn_vkCreateInstance);\n") == std::string::npos);
+
+		REQUIRE(loader.find(R"(static void vgen_load_hot_device_procs(VkDevice device)
+{
+
+#if defined(test_feature)
+
+	pfn_vkGetDeviceProcAddr = (PFN_vkGetDeviceProcAddr)vkGetDeviceProcAddr(device, "vkGetDeviceProcAddr");
+	pfn_hot_fn = (PFN_hot_fn)vkGetDeviceProcAddr(device, "hot_fn");
+
+#endif // defined(test_feature)
+}
+
+static void vgen_load_background_device_procs(VkDevice device)
+{
+
+#if defined(test_feature)
+
+	pfn_test_fn = (PFN_test_fn)vkGetDeviceProcAddr(device, "test_fn");
+
+#endif // defined(test_feature)
+}
+)") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		auto files = vgen::generate_loader(plan, options);
+
+		REQUIRE(files[0].contents.find("void vgen_load_device_procs_async(VkDevice device);\nvoid vgen_wait_device_procs(void);\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("void vgen_load_device_procs_async(VkDevice device)\n") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.hot_commands = {"hot_fn"}}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.async_device_load = true, .hot_commands = {"ext_fn"}}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.async_device_load = true, .hot_commands = {"vkCreateInstance"}}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.async_device_load = true, .hot_commands = {"vkGetDeviceProcAddr"}}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::table, .async_device_load = true}));
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.thread_safe = true, .async_device_load = true}));
+	}
+}
+
+TEST_CASE("availability", "[plan][table]")
+{
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a) && defined(ext_b)"s, "defined(ext_c)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("group names")
+	{
+		REQUIRE(vgen::get_group_name(plan.blocks[0]) == "test_feature");
+		REQUIRE(vgen::get_group_name(plan.blocks[1]) == "ext_a_and_ext_b_or_ext_c");
+	}
+
+	SECTION("groups are ranges of the command enum")
+	{
+		fmt::memory_buffer out;
+		vgen::write_group_table(out, plan);
+		auto table = to_string(out);
+
+		REQUIRE(table.find(R"(} vgen_group_commands[vgen_group_count + 1] = {
+#if defined(test_feature)
+	{vgen_command_test_fn, 1},
+#endif // defined(test_feature)
+#if defined(ext_a) && defined(ext_b) || defined(ext_c)
+	{vgen_command_ext_fn, 1},
+#endif // defined(ext_a) && defined(ext_b) || defined(ext_c)
+	{0, 0},
+};
+)") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		vgen::generator_options options{.init = vgen::init_mode::table, .availability = true};
+		auto files = vgen::generate_loader(plan, options);
+
+		REQUIRE(files[0].contents.find("\tvgen_group_test_feature,\n#endif // defined(test_feature)\n#if defined(ext_a) && defined(ext_b) || defined(ext_c)\n\tvgen_group_ext_a_and_ext_b_or_ext_c,\n") != std::string::npos);
+		REQUIRE(files[0].contents.find("int vgen_has_group(enum vgen_group group);\n") != std::string::npos);
+		REQUIRE(files[0].contents.find("\tuint32_t available_groups[vgen_group_count / 32 + 1];\n") != std::string::npos);
+		REQUIRE(files[0].contents.find("int vgen_has_command(enum vgen_command command, const struct vgen_vulkan_api *vk);\n") != std::string::npos);
+
+		REQUIRE(files[1].contents.find("static uint32_t vgen_available_commands[vgen_command_count / 32 + 1];\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("\tvgen_record_availability(vk);\n}\n\nvoid vgen_load_device_procs(") != std::string::npos);
+		REQUIRE(files[1].contents.find("\tvgen_record_availability();\n}\n") != std::string::npos);
+		REQUIRE(files[1].contents.find("\t\tif (vgen_get_field(vk, i))\n\t\t\tvk->available_commands[i / 32] |= (uint32_t)1 << (i % 32);\n") != std::string::npos);
+		REQUIRE(files[1].contents.find(R"(
+int vgen_has_group(enum vgen_group group, const struct vgen_vulkan_api *vk)
+{
+	return (int)(vk->available_groups[group / 32] >> (group % 32)) & 1;
+}
+)") != std::string::npos);
+
+		REQUIRE(vgen::generate_loader(plan, vgen::generator_options{.init = vgen::init_mode::table})[1].contents.find("vgen_record_availability") == std::string::npos);
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.availability = true}));
+	}
+}
+
+TEST_CASE("proc lookup", "[plan][table]")
+{
+	SECTION("every name gets its own position")
+	{
+		std::vector<std::string> storage;
+		for (int i = 0; i < 1000; ++i)
+			storage.emplace_back(fmt::format("vkCommand{0}", i));
+
+		std::vector<std::string_view> names(begin(storage), end(storage));
+		auto hash = vgen::build_perfect_hash(names);
+
+		std::vector<std::size_t> found;
+		for (auto name : names)
+			found.emplace_back(hash.names[vgen::perfect_hash_position(hash, name)]);
+
+		std::vector<std::size_t> expected(names.size());
+		for (std::size_t i = 0; i < expected.size(); ++i)
+			expected[i] = i;
+
+		REQUIRE(found == expected);
+
+		auto again = vgen::build_perfect_hash(names);
+		REQUIRE(again.seeds == hash.seeds);
+		REQUIRE(again.names == hash.names);
+	}
+
+	SECTION("names must be unique")
+	{
+		REQUIRE_THROWS(vgen::build_perfect_hash({"vkA"sv, "vkB"sv, "vkA"sv}));
+	}
+
+	vgen::command_map commands{
+		{"test_fn"s,
+			vgen::command_data{
+				.name = "test_fn",
+				.prototype = "void test_fn",
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = true,
+			}},
+		{"ext_fn"s,
+			vgen::command_data{
+				.name = "ext_fn",
+				.prototype = "int ext_fn",
+				.params = "Bar bar",
+				.param_names = "bar",
+				.comment = "",
+				.returns_void = false,
+				.is_device_command = false,
+			}},
+	};
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"test_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{std::set{"defined(ext_a)"s}, "ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+
+	SECTION("commands compiled out have no slot")
+	{
+		fmt::memory_buffer out;
+		vgen::write_proc_hash_table(out, plan);
+		auto table = to_string(out);
+
+		REQUIRE(table.find("static const uint16_t vgen_proc_commands[2] = {\n") != std::string::npos);
+		REQUIRE(table.find(R"(static const uint16_t vgen_proc_slots[2] = {
+#if defined(test_feature)
+	vgen_command_test_fn,
+#else
+	vgen_command_count,
+#endif // defined(test_feature)
+#if defined(ext_a)
+	vgen_command_ext_fn,
+#else
+	vgen_command_count,
+#endif // defined(ext_a)
+};
+)") != std::string::npos);
+	}
+
+	SECTION("generated files")
+	{
+		vgen::generator_options options{.init = vgen::init_mode::table, .proc_lookup = true};
+		auto files = vgen::generate_loader(plan, options);
+
+		REQUIRE(files[0].contents.find("PFN_vkVoidFunction vgen_get_proc(const char *name);\n") != std::string::npos);
+		REQUIRE(files[0].contents.find("PFN_vkVoidFunction vgen_get_proc(const char *name, const struct vgen_vulkan_api *vk);\n") != std::string::npos);
+		REQUIRE(files[1].contents.find(R"(
+PFN_vkVoidFunction vgen_get_proc(const char *name, const struct vgen_vulkan_api *vk)
+{
+	size_t command = vgen_find_command(name);
+	return command != vgen_command_count ? vgen_get_field(vk, command) : 0;
+}
+)") != std::string::npos);
+
+		REQUIRE_THROWS(vgen::generate_loader(plan, vgen::generator_options{.proc_lookup = true}));
+	}
+}
+
+TEST_CASE("registry filter", "[filter]")
+{
+	SECTION("glob_match")
+	{
+		REQUIRE(vgen::glob_match("VK_KHR_*", "VK_KHR_surface"));
+		REQUIRE(vgen::glob_match("*", ""));
+		REQUIRE(vgen::glob_match("VK_?HR_*face", "VK_KHR_surface"));
+		REQUIRE(vgen::glob_match("*_surface", "VK_GOOGLE_surfaceless_query") == false);
+		REQUIRE(vgen::glob_match("*surface", "VK_KHR_win32_surface"));
+		REQUIRE(vgen::glob_match("VK_KHR_*", "VK_EXT_debug_utils") == false);
+		REQUIRE(vgen::glob_match("VK_KHR_swapchain", "VK_KHR_swapchain_mutable_format") == false);
+	}
+
+	SECTION("versions")
+	{
+		REQUIRE(vgen::parse_version("1.2") == vgen::version_number{1, 2});
+		REQUIRE_FALSE(vgen::parse_version("1"));
+		REQUIRE_FALSE(vgen::parse_version("1.x"));
+		REQUIRE_FALSE(vgen::parse_version(".1"));
+		REQUIRE(vgen::feature_version("VK_VERSION_1_3") == vgen::version_number{1, 3});
+		REQUIRE_FALSE(vgen::feature_version("VK_KHR_surface"));
+	}
+
+	SECTION("features newer than the api version are dropped")
+	{
+		std::vector<vgen::feature_data> features{
+			{.name = "VK_VERSION_1_0"},
+			{.name = "VK_VERSION_1_1"},
+			{.name = "VK_VERSION_1_2"},
+		};
+
+		auto filtered = vgen::filter_features(features, vgen::registry_filter{.api_version = vgen::version_number{1, 1}});
+		REQUIRE(filtered.size() == 2);
+		REQUIRE(filtered.back().name == "VK_VERSION_1_1");
+
+		REQUIRE(vgen::filter_features(features, vgen::registry_filter{}).size() == 3);
+	}
+
+	SECTION("extension requirements that can't be met are dropped")
+	{
+		vgen::extension_map extensions{
+			{{"defined(VK_KHR_surface)"s}, "vkDestroySurfaceKHR"s},
+			{{"defined(VK_EXT_debug_utils)"s}, "vkCreateDebugUtilsMessengerEXT"s},
+			{{"defined(VK_KHR_device_group) && defined(VK_KHR_surface)"s, "defined(VK_KHR_swapchain) && defined(VK_VERSION_1_1)"s}, "vkGetDeviceGroupPresentCapabilitiesKHR"s},
+		};
+
+		auto filtered = vgen::filter_extensions(extensions,
+			vgen::registry_filter{
+				.api_version = vgen::version_number{1, 0},
+				.extensions = {"VK_KHR_*"},
+				.exclude_extensions = {"VK_KHR_swapchain"},
+			});
+
+		REQUIRE(filtered == vgen::extension_map{
+								{{"defined(VK_KHR_surface)"s}, "vkDestroySurfaceKHR"s},
+								{{"defined(VK_KHR_device_group) && defined(VK_KHR_surface)"s}, "vkGetDeviceGroupPresentCapabilitiesKHR"s},
+							});
+
+		filtered = vgen::filter_extensions(extensions, vgen::registry_filter{.exclude_extensions = {"VK_KHR_surface"}});
+		REQUIRE(filtered == vgen::extension_map{
+								{{"defined(VK_EXT_debug_utils)"s}, "vkCreateDebugUtilsMessengerEXT"s},
+								{{"defined(VK_KHR_swapchain) && defined(VK_VERSION_1_1)"s}, "vkGetDeviceGroupPresentCapabilitiesKHR"s},
+							});
+	}
+}
+
+TEST_CASE("referenced commands", "[filter]")
+{
+	vgen::command_map commands;
+	for (auto [name, alias_of] : {
+			 std::pair{"vkGetInstanceProcAddr"s, ""s},
+			 std::pair{"vkGetDeviceProcAddr"s, ""s},
+			 std::pair{"vkCreateInstance"s, ""s},
+			 std::pair{"vkEnumerateInstanceExtensionProperties"s, ""s},
+			 std::pair{"vkEnumerateInstanceLayerProperties"s, ""s},
+			 std::pair{"vkCmdDraw"s, ""s},
+			 std::pair{"vkQueueWaitIdle"s, ""s},
+			 std::pair{"vkTrimCommandPool"s, ""s},
+			 std::pair{"vkTrimCommandPoolKHR"s, "vkTrimCommandPool"s},
+		 })
+	{
+		commands.emplace(name, vgen::command_data{.name = name, .alias_of = alias_of});
+	}
+
+	SECTION("find_referenced_commands")
+	{
+		auto source = R"(
+			vkCmdDraw(cmd, 3, 1, 0, 0);
+			PFN_vkTrimCommandPoolKHR trim = 0;
+			vkCmdDrawIndexed(cmd); // not in the registry
+			my_vkQueueWaitIdle(); // not a vulkan name
+		)"sv;
+
+		REQUIRE(vgen::find_referenced_commands(source, commands) == std::set{"vkCmdDraw"s, "vkTrimCommandPoolKHR"s});
+
+		// object files hold symbol names between binary data, mangled names prefix their length
+		auto object = "\x7f" "ELF\0\x01vkQueueWaitIdle\0_Z4drawP13PFN_vkCmdDrawi\0"sv;
+		REQUIRE(vgen::find_referenced_commands(object, commands) == std::set{"vkCmdDraw"s, "vkQueueWaitIdle"s});
+
+		// Mach-O prefixes C symbols with an underscore
+		auto mach_o = "\xcf\xfa\xed\xfe\0_vkQueueWaitIdle\0__Z4drawP13PFN_vkCmdDrawi\0"sv;
+		REQUIRE(vgen::find_referenced_commands(mach_o, commands) == std::set{"vkCmdDraw"s, "vkQueueWaitIdle"s});
+
+		// Windows import references go through __imp_ symbols
+		auto coff = "\x64\x86\0__imp_vkQueueWaitIdle\0__imp_vkTrimCommandPoolKHR\0"sv;
+		REQUIRE(vgen::find_referenced_commands(coff, commands) == std::set{"vkQueueWaitIdle"s, "vkTrimCommandPoolKHR"s});
+	}
+
+	SECTION("closure keeps aliases and what the loader needs")
+	{
+		auto closure = vgen::get_command_closure({"vkTrimCommandPoolKHR"s}, commands);
+		REQUIRE(closure == std::set{"vkCreateInstance"s, "vkEnumerateInstanceExtensionProperties"s, "vkEnumerateInstanceLayerProperties"s, "vkGetDeviceProcAddr"s, "vkGetInstanceProcAddr"s, "vkTrimCommandPool"s, "vkTrimCommandPoolKHR"s});
+	}
+
+	SECTION("filtering drops empty sections and features")
+	{
+		std::vector<vgen::feature_data> features{
+			{.name = "VK_VERSION_1_0", .sections = {{.commands = {"vkGetInstanceProcAddr"s, "vkCmdDraw"s}}, {.commands = {"vkQueueWaitIdle"s}}}},
+			{.name = "VK_VERSION_1_1", .sections = {{.commands = {"vkTrimCommandPool"s}}}},
+		};
+
+		auto filtered = vgen::filter_feature_commands(features, {"vkGetInstanceProcAddr"s});
+		REQUIRE(filtered.size() == 1);
+		REQUIRE(filtered[0].sections.size() == 1);
+		REQUIRE(filtered[0].sections[0].commands == std::vector{"vkGetInstanceProcAddr"s});
+
+		vgen::extension_map extensions{
+			{{"defined(VK_KHR_maintenance1)"s}, "vkTrimCommandPoolKHR"s},
+		};
+
+		REQUIRE(vgen::filter_extension_commands(extensions, {"vkTrimCommandPoolKHR"s}) == extensions);
+		REQUIRE(vgen::filter_extension_commands(extensions, {"vkCmdDraw"s}).empty());
+	}
+}
+
+TEST_CASE("emission stats", "[plan][stats]")
+{
+	vgen::command_map commands;
+	auto add_command = [&](const std::string &name, bool is_device_command) {
+		commands.emplace(name,
+			vgen::command_data{
+				.name = name,
+				.prototype = "void " + name,
+				.params = "Foo foo",
+				.param_names = "foo",
+				.comment = "",
+				.returns_void = true,
+				.is_device_command = is_device_command,
+			});
+	};
+
+	// the parser classifies vkCreateInstance as a device command, its first parameter is not an instance or physical device
+	add_command("vkCreateInstance", true);
+	add_command("test_instance_fn", false);
+	add_command("test_device_fn", true);
+	add_command("test_ext_fn", true);
+
+	vgen::feature_data feature{
+		.name = "test_feature",
+		.comment = "",
+		.sections = {vgen::section_data{.comment = "", .commands = {"vkCreateInstance", "test_instance_fn", "test_device_fn"}}},
+	};
+
+	vgen::extension_map extensions{
+		{{"defined(test_ext)"s}, "test_ext_fn"s},
+	};
+
+	auto plan = vgen::build_emission_plan("42"sv, std::vector{feature}, extensions, commands);
+	auto stats = vgen::get_emission_stats(plan);
+
+	SECTION("counts per block")
+	{
+		REQUIRE(stats.blocks.size() == 2);
+
+		const auto &core = stats.blocks[0];
+		REQUIRE(core.name == "test_feature");
+		REQUIRE(core.commands == 3);
+		REQUIRE(core.wrappers == 3);
+		REQUIRE(core.global_init_calls == 1);
+		REQUIRE(core.instance_init_calls == 2);
+		REQUIRE(core.device_init_calls == 1);
+
+		const auto &ext = stats.blocks[1];
+		REQUIRE(ext.name == "defined(test_ext)");
+		REQUIRE(ext.kind == vgen::block_kind::extension);
+		REQUIRE(ext.instance_init_calls == 1);
+		REQUIRE(ext.device_init_calls == 1);
+
+		fmt::memory_buffer fields;
+		vgen::write_struct_block_fields(fields, plan.blocks[1]);
+		REQUIRE(ext.header_bytes == fields.size());
+
+		REQUIRE(stats.total.commands == 4);
+		REQUIRE(stats.total.device_init_calls == 2);
+		REQUIRE(stats.total.source_bytes == core.source_bytes + ext.source_bytes);
+	}
+
+	SECTION("json")
+	{
+		fmt::memory_buffer out;
+		vgen::write_stats_json(out, stats);
+
+		auto json = to_string(out);
+		REQUIRE(json.starts_with("{\n\t\"blocks\": [\n"));
+		REQUIRE(json.find(R"json({"name": "defined(test_ext)", "kind": "extension", "commands": 1, "wrappers": 1, "global_init_calls": 0, "instance_init_calls": 1, "device_init_calls": 1, )json") != std::string::npos);
+		REQUIRE(json.find(R"("total": {"name": "total", "commands": 4, )") != std::string::npos);
+	}
+}
+
+TEST_CASE("phase timings", "[timings]")
+{
+	using namespace std::chrono_literals;
+
+	SECTION("phases are recorded in order")
+	{
+		vgen::phase_timings timings;
+
+		vgen::begin_phase(timings, "first");
+		vgen::end_phase(timings);
+		vgen::begin_phase(timings, "second");
+		vgen::end_phase(timings, 42);
+
+		REQUIRE(timings.phases.size() == 2);
+		REQUIRE(timings.phases[0].name == "first");
+		REQUIRE(timings.phases[0].start == 0ns);
+		REQUIRE(timings.phases[0].output_bytes == 0);
+		REQUIRE(timings.phases[1].name == "second");
+		REQUIRE(timings.phases[1].start >= timings.phases[0].start + timings.phases[0].wall);
+		REQUIRE(timings.phases[1].output_bytes == 42);
+	}
+
+	SECTION("counted allocations")
+	{
+		auto before = vgen::get_allocation_totals();
+		auto *ptr = vgen::counted_allocate(100);
+		auto during = vgen::get_allocation_totals();
+		vgen::counted_deallocate(ptr);
+		auto after = vgen::get_allocation_totals();
+
+		REQUIRE(during.count == before.count + 1);
+		REQUIRE(during.bytes == before.bytes + 100);
+		REQUIRE(during.live == before.live + 100);
+		REQUIRE(during.peak >= during.live);
+		REQUIRE(after.live == before.live);
+
+		vgen::phase_timings timings;
+		vgen::begin_phase(timings, "allocate");
+		vgen::counted_deallocate(vgen::counted_allocate(64));
+		vgen::counted_deallocate(vgen::counted_allocate(32));
+		vgen::end_phase(timings);
+
+		REQUIRE(timings.phases[0].allocations == 2);
+		REQUIRE(timings.phases[0].allocated_bytes == 96);
+		REQUIRE(timings.phases[0].peak_bytes == 64);
+	}
+
+	vgen::phase_timings timings{
+		.phases = {
+			vgen::phase_timing{.name = "read", .start = 0ns, .wall = 1500us, .cpu = 1ms, .allocations = 10, .allocated_bytes = 1000, .peak_bytes = 800, .output_bytes = 0},
+			vgen::phase_timing{.name = "write", .start = 2ms, .wall = 500us, .cpu = 2ms, .allocations = 5, .allocated_bytes = 200, .peak_bytes = 900, .output_bytes = 300},
+		},
+	};
+
+	SECTION("total")
+	{
+		auto total = vgen::get_timings_total(timings);
+		REQUIRE(total.name == "total");
+		REQUIRE(total.wall == 2500us);
+		REQUIRE(total.cpu == 3ms);
+		REQUIRE(total.allocations == 15);
+		REQUIRE(total.allocated_bytes == 1200);
+		REQUIRE(total.peak_bytes == 900);
+		REQUIRE(total.output_bytes == 300);
+	}
+
+	SECTION("text report")
+	{
+		fmt::memory_buffer out;
+		vgen::write_timings_text(out, timings);
+
+		REQUIRE(to_string(out) ==
+				"   wall ms     cpu ms     allocs  alloc bytes   peak bytes output bytes  phase\n"
+				"     1.500      1.000         10         1000          800            0  read\n"
+				"     0.500      2.000          5          200          900          300  write\n"
+				"     2.500      3.000         15         1200          900          300  total\n");
+	}
+
+	SECTION("json report")
+	{
+		fmt::memory_buffer out;
+		vgen::write_timings_json(out, timings);
+
+		REQUIRE(to_string(out) == R"json({
+	"phases": [
+		{"name": "read", "start_ns": 0, "wall_ns": 1500000, "cpu_ns": 1000000, "allocations": 10, "allocated_bytes": 1000, "peak_bytes": 800, "output_bytes": 0},
+		{"name": "write", "start_ns": 2000000, "wall_ns": 500000, "cpu_ns": 2000000, "allocations": 5, "allocated_bytes": 200, "peak_bytes": 900, "output_bytes": 300}
+	],
+	"total": {"name": "total", "start_ns": 0, "wall_ns": 2500000, "cpu_ns": 3000000, "allocations": 15, "allocated_bytes": 1200, "peak_bytes": 900, "output_bytes": 300}
+}
+)json");
+	}
+
+	SECTION("chrome trace")
+	{
+		fmt::memory_buffer out;
+		vgen::write_timings_trace(out, timings);
+
+		REQUIRE(to_string(out) == R"json({
+	"displayTimeUnit": "ms",
+	"traceEvents": [
+		{"name": "read", "cat": "vgen", "ph": "X", "pid": 1, "tid": 1, "ts": 0.000, "dur": 1500.000, "args": {"cpu_us": 1000.000, "allocations": 10, "allocated_bytes": 1000, "peak_bytes": 800, "output_bytes": 0}},
+		{"name": "write", "cat": "vgen", "ph": "X", "pid": 1, "tid": 1, "ts": 2000.000, "dur": 500.000, "args": {"cpu_us": 2000.000, "allocations": 5, "allocated_bytes": 200, "peak_bytes": 900, "output_bytes": 300}}
+	]
+}
+)json");
 	}
 }
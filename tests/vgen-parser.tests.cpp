@@ -97,6 +97,34 @@ TEST_CASE("command parsing", "[command][parser]")
 	}
 }
 
+TEST_CASE("alias parsing", "[command][parser]")
+{
+	auto doc = load_fragment(R"xml(<?xml version="1.0" encoding="UTF-8"?>
+<registry>
+    <commands>
+        <command>
+            <proto><type>void</type> <name>vkTrimCommandPool</name></proto>
+            <param><type>VkDevice</type> <name>device</name></param>
+            <param><type>VkCommandPool</type> <name>commandPool</name></param>
+            <param optional="true"><type>VkCommandPoolTrimFlags</type> <name>flags</name></param>
+        </command>
+        <command name="vkTrimCommandPoolKHR" alias="vkTrimCommandPool"/>
+        <command name="vkTrimCommandPoolEXT" alias="vkTrimCommandPoolKHR"/>
+    </commands>
+</registry>
+)xml");
+
+	auto commands = vgen::read_commands(doc);
+	REQUIRE(commands.size() == 3);
+
+	REQUIRE(commands.at("vkTrimCommandPool").alias_of == "");
+	REQUIRE(commands.at("vkTrimCommandPoolKHR").alias_of == "vkTrimCommandPool");
+	REQUIRE(commands.at("vkTrimCommandPoolKHR").prototype == "void vkTrimCommandPoolKHR");
+
+	// aliases of aliases refer to the original command
+	REQUIRE(commands.at("vkTrimCommandPoolEXT").alias_of == "vkTrimCommandPool");
+}
+
 TEST_CASE("feature parsing", "[feature][parser]")
 {
 	auto doc = load_fragment(
@@ -0,0 +1,408 @@
+#include <synth.hpp>
+#include <vgen.hpp>
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+#if !defined(VGEN_PERF_BASELINE)
+#define VGEN_PERF_BASELINE "perf-baseline.txt"
+#endif
+
+#if !defined(VGEN_PERF_SNAPSHOT)
+#define VGEN_PERF_SNAPSHOT "vk-snapshot.xml"
+#endif
+
+// peak memory is measured through the vgen allocation hooks
+void *operator new(std::size_t size)
+{
+	if (auto ptr = vgen::counted_allocate(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+	vgen::counted_deallocate(ptr);
+}
+
+namespace
+{
+	// CTest SKIP_RETURN_CODE, used when nothing regressed but a registry or phase has no baseline to compare with
+	constexpr int skip_return_code = 77;
+
+	struct phase_measurement
+	{
+		// wall time as a multiple of the calibration workload, so a baseline recorded on one machine holds on another
+		double time = 0;
+		std::size_t peak_bytes = 0;
+	};
+
+	// registry -> phase -> measurement
+	using measurements = std::map<std::string, std::map<std::string, phase_measurement>>;
+
+	struct tolerances
+	{
+		double time = 0.5;   // allowed fraction slower than the baseline
+		double memory = 0.1; // allowed fraction more peak memory than the baseline
+		std::size_t memory_slack = 16 * 1024;
+
+		// phases adding up to less than this over a batch, on both sides, are too noisy to judge
+		std::chrono::duration<double, std::milli> min_time = 1ms;
+	};
+
+	std::string read_file(const fs::path &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("Unable to read " + path.string());
+
+		return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+	}
+
+	std::string get_registry(const std::string &name)
+	{
+		if (name == "snapshot")
+			return read_file(VGEN_PERF_SNAPSHOT);
+
+		fmt::memory_buffer out;
+		if (name == "synth-1x")
+			vgen::write_synthetic_registry(out, vgen::registry_shape{});
+		else if (name == "synth-10x")
+			vgen::write_synthetic_registry(out, vgen::scale_registry_shape(vgen::registry_shape{}, 10));
+		else
+			throw std::runtime_error(fmt::format("Unknown registry '{0}', expected snapshot, synth-1x or synth-10x", name));
+
+		return to_string(out);
+	}
+
+	// a fixed workload of the kind the generator does, formatting, hashing and sorting strings
+	// the fastest of several runs is the unit phase times are measured in
+	std::chrono::nanoseconds calibrate()
+	{
+		auto best = std::chrono::nanoseconds::max();
+
+		for (int run = 0; run < 5; ++run)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			std::vector<std::string> names;
+			std::unordered_map<std::string, std::size_t> index;
+			for (std::size_t i = 0; i < 20000; ++i)
+			{
+				names.emplace_back(fmt::format("vkCmdCalibrate{0:06}", i * 7919 % 20000));
+				index.emplace(names.back(), i);
+			}
+
+			std::sort(begin(names), end(names));
+
+			fmt::memory_buffer out;
+			for (const auto &name : names)
+				fmt::format_to(std::back_inserter(out), "\tpfn_{0} = (PFN_{0})load(context, \"{0}\"); // {1}\n", name, index[name]);
+
+			best = std::min(best, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+		}
+
+		return best;
+	}
+
+	// one run of the generator pipeline on the registry, its phases are appended to timings
+	void run_pipeline(const std::string &registry, vgen::phase_timings &timings)
+	{
+		pugi::xml_document doc;
+
+		vgen::begin_phase(timings, "load_document");
+		auto parsed = doc.load_buffer(registry.data(), registry.size(), pugi::parse_default | pugi::parse_trim_pcdata);
+		vgen::end_phase(timings);
+		if (!parsed)
+			throw std::runtime_error(parsed.description());
+
+		vgen::begin_phase(timings, "read_commands");
+		auto commands = vgen::read_commands(doc);
+		vgen::end_phase(timings);
+
+		vgen::begin_phase(timings, "read_features");
+		auto features = vgen::read_features(doc);
+		vgen::end_phase(timings);
+
+		vgen::begin_phase(timings, "read_extensions");
+		auto extensions = vgen::read_extensions(doc);
+		vgen::end_phase(timings);
+
+		vgen::begin_phase(timings, "build_emission_plan");
+		auto plan = vgen::build_emission_plan(vgen::read_vulkan_header_version(doc), features, extensions, commands);
+		vgen::end_phase(timings);
+
+		vgen::begin_phase(timings, "generate_loader");
+		auto files = vgen::generate_loader(plan);
+		vgen::end_phase(timings);
+	}
+
+	// pipeline runs an iteration adds up, a registry as small as the snapshot runs in microseconds per phase,
+	// below what the clock resolves, so its runs are batched until the batch lasts at least min_batch
+	std::size_t get_batch_size(const std::string &registry, std::chrono::duration<double, std::milli> min_batch)
+	{
+		vgen::phase_timings timings;
+		run_pipeline(registry, timings);
+
+		auto once = std::chrono::duration<double, std::milli>(vgen::get_timings_total(timings).wall);
+		return once.count() > 0 ? std::max<std::size_t>(static_cast<std::size_t>(std::ceil(min_batch / once)), 1) : 1;
+	}
+
+	// runs batches of the generator pipeline on the registry, keeping the fastest time per run and the largest peak of every phase
+	std::map<std::string, phase_measurement> measure(const std::string &registry, std::size_t iterations, std::size_t batch, std::chrono::nanoseconds calibration)
+	{
+		std::map<std::string, phase_measurement> result;
+
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			vgen::phase_timings timings;
+			for (std::size_t run = 0; run < batch; ++run)
+				run_pipeline(registry, timings);
+
+			// the total spans the whole batch, the phases of every run are summed by name
+			std::map<std::string, vgen::phase_timing> phases;
+			phases.emplace("total", vgen::get_timings_total(timings));
+			for (const auto &phase : timings.phases)
+			{
+				auto &sum = phases[phase.name];
+				sum.wall += phase.wall;
+				sum.peak_bytes = std::max(sum.peak_bytes, phase.peak_bytes);
+			}
+
+			for (const auto &[name, phase] : phases)
+			{
+				auto time = std::chrono::duration<double>(phase.wall) / calibration / static_cast<double>(batch);
+				auto [entry, inserted] = result.try_emplace(name, phase_measurement{.time = time, .peak_bytes = phase.peak_bytes});
+				if (!inserted)
+				{
+					entry->second.time = std::min(entry->second.time, time);
+					entry->second.peak_bytes = std::max(entry->second.peak_bytes, phase.peak_bytes);
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// lines of "registry phase time peak_bytes", # starts a comment
+	measurements read_baseline(const fs::path &path)
+	{
+		measurements baseline;
+
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line.starts_with('#'))
+				continue;
+
+			std::istringstream fields(line);
+			std::string registry, phase;
+			phase_measurement measurement;
+			if (!(fields >> registry >> phase >> measurement.time >> measurement.peak_bytes))
+				throw std::runtime_error(fmt::format("{0}: malformed baseline line '{1}'", path.string(), line));
+
+			baseline[registry][phase] = measurement;
+		}
+
+		return baseline;
+	}
+
+	void write_baseline(const fs::path &path, const measurements &baseline)
+	{
+		fmt::memory_buffer out;
+		fmt::format_to(std::back_inserter(out), R"(# vgen performance baseline, recorded with vgen-perf --update-baseline on an optimized build
+# refresh it from a build configured with -DCMAKE_BUILD_TYPE=Release -DBUILD_PERF_TESTS=ON:
+#   cmake --build <build> --target vgen-perf && <build>/tests/vgen-perf --update-baseline
+# a registry or phase missing here skips its perf test, so record it again after adding a registry or phase
+# time is phase wall time divided by the time of vgen-perf's calibration workload, peak_bytes is from the vgen allocation hooks
+# registry phase time peak_bytes
+)");
+
+		for (const auto &[registry, phases] : baseline)
+			for (const auto &[phase, measurement] : phases)
+				fmt::format_to(std::back_inserter(out), "{0} {1} {2:.6g} {3}\n", registry, phase, measurement.time, measurement.peak_bytes);
+
+		std::ofstream(path) << to_string(out);
+	}
+
+	// prints a row per phase and returns the number of regressions, phases without a baseline are added to missing
+	std::size_t compare(const std::string &registry, const std::map<std::string, phase_measurement> &measured, const std::map<std::string, phase_measurement> &baseline, std::size_t batch, std::chrono::nanoseconds calibration, const tolerances &limits, std::size_t &missing)
+	{
+		auto milliseconds = [&](double time) {
+			return time * std::chrono::duration<double, std::milli>(calibration).count();
+		};
+
+		std::size_t regressions = 0;
+
+		fmt::print("{0:<20} {1:>12} {2:>12} {3:>8} {4:>14} {5:>14}  {6}\n", "phase", "baseline ms", "measured ms", "ratio", "baseline peak", "measured peak", "status");
+
+		for (const auto &[phase, measurement] : measured)
+		{
+			auto expected = baseline.find(phase);
+			if (expected == end(baseline))
+			{
+				fmt::print("{0:<20} {1:>12} {2:>12.3f} {3:>8} {4:>14} {5:>14}  NO BASELINE\n", phase, "-", milliseconds(measurement.time), "-", "-", measurement.peak_bytes);
+				++missing;
+				continue;
+			}
+
+			auto ratio = expected->second.time > 0 ? measurement.time / expected->second.time : 1.0;
+			auto judged = std::max(milliseconds(measurement.time), milliseconds(expected->second.time)) * static_cast<double>(batch) >= limits.min_time.count();
+
+			std::string status = "ok";
+			if (judged && ratio > 1 + limits.time)
+				status = fmt::format("SLOWER by more than {0:.0f}%", limits.time * 100);
+			else if (measurement.peak_bytes > static_cast<std::size_t>(static_cast<double>(expected->second.peak_bytes) * (1 + limits.memory)) + limits.memory_slack)
+				status = fmt::format("MORE MEMORY by more than {0:.0f}%", limits.memory * 100);
+			else if (judged && ratio < 1 - limits.time)
+				status = "faster, consider updating the baseline";
+
+			if (status.starts_with("SLOWER") || status.starts_with("MORE"))
+				++regressions;
+
+			fmt::print("{0:<20} {1:>12.3f} {2:>12.3f} {3:>8.2f} {4:>14} {5:>14}  {6}\n", phase, milliseconds(expected->second.time), milliseconds(measurement.time), ratio, expected->second.peak_bytes, measurement.peak_bytes, status);
+		}
+
+		if (regressions)
+			fmt::print("{0}: {1} phase(s) regressed\n", registry, regressions);
+
+		return regressions;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		cxxopts::Options options("vgen-perf", "Compares generator phase timings and peak memory against a stored baseline");
+
+		// clang-format off
+		options.add_options()
+			("h,help", "Show this help")
+			("registry", "registries to run: snapshot, synth-1x, synth-10x", cxxopts::value<std::vector<std::string>>()->default_value("snapshot,synth-1x,synth-10x"))
+			("baseline", "baseline file", cxxopts::value<std::string>()->default_value(VGEN_PERF_BASELINE))
+			("update-baseline", "record the measurements of the selected registries into the baseline instead of comparing")
+			("n,iterations", "runs of the pipeline per registry, the fastest counts", cxxopts::value<std::size_t>()->default_value("5"))
+			("time-tolerance", "fraction slower than the baseline a phase may get, e.g. 0.5", cxxopts::value<double>()->default_value("0.5"))
+			("memory-tolerance", "fraction more peak memory than the baseline a phase may use, e.g. 0.1", cxxopts::value<double>()->default_value("0.1"))
+			("min-time-ms", "phases adding up to less than this over a batch, both in the baseline and now, are not timed", cxxopts::value<double>()->default_value("1"))
+			("min-batch-ms", "repeat the pipeline within an iteration until it lasts this long, times are per run", cxxopts::value<double>()->default_value("50"));
+		// clang-format on
+
+		auto parsed_options = options.parse(argc, argv);
+		if (parsed_options.count("help"))
+		{
+			fmt::print("{0}", options.help());
+			return 0;
+		}
+
+		auto registries = parsed_options["registry"].as<std::vector<std::string>>();
+		auto baseline_path = fs::path(parsed_options["baseline"].as<std::string>());
+		auto iterations = std::max<std::size_t>(parsed_options["iterations"].as<std::size_t>(), 1);
+		auto min_batch = std::chrono::duration<double, std::milli>(parsed_options["min-batch-ms"].as<double>());
+
+		tolerances limits{
+			.time = parsed_options["time-tolerance"].as<double>(),
+			.memory = parsed_options["memory-tolerance"].as<double>(),
+			.min_time = std::chrono::duration<double, std::milli>(parsed_options["min-time-ms"].as<double>()),
+		};
+
+		pugi::set_memory_management_functions(vgen::counted_allocate, vgen::counted_deallocate);
+
+		auto calibration = calibrate();
+		fmt::print("calibration workload: {0:.3f} ms\n", std::chrono::duration<double, std::milli>(calibration).count());
+
+		auto baseline = fs::exists(baseline_path) ? read_baseline(baseline_path) : measurements{};
+
+		std::size_t regressions = 0;
+		std::size_t missing = 0;
+
+		for (const auto &registry : registries)
+		{
+			auto contents = get_registry(registry);
+			auto batch = get_batch_size(contents, min_batch);
+			fmt::print("\n{0}: {1} bytes, {2} iterations of {3} runs\n", registry, contents.size(), iterations, batch);
+
+			auto measured = measure(contents, iterations, batch, calibration);
+
+			if (parsed_options.count("update-baseline"))
+			{
+				baseline[registry] = measured;
+				continue;
+			}
+
+			if (auto expected = baseline.find(registry); expected != end(baseline))
+				regressions += compare(registry, measured, expected->second, batch, calibration, limits, missing);
+			else
+			{
+				fmt::print("no baseline for {0} in {1}\n", registry, baseline_path.string());
+				++missing;
+			}
+		}
+
+		if (parsed_options.count("update-baseline"))
+		{
+			write_baseline(baseline_path, baseline);
+			fmt::print("\nWrote {0}\n", baseline_path.string());
+			return 0;
+		}
+
+		if (regressions)
+			return 1;
+
+		if (missing)
+		{
+			fmt::print("skipped, record the missing measurements with vgen-perf --update-baseline on an optimized build\n");
+			return skip_return_code;
+		}
+
+		return 0;
+	}
+	catch (std::exception &e)
+	{
+		fmt::print(stderr, "{0}\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,261 @@
+#include <synth.hpp>
+#include <vgen.hpp>
+
+#include <cxxopts.hpp>
+#include <fmt/format.h>
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+#if !defined(VGEN_STRESS_CC)
+#define VGEN_STRESS_CC "cc"
+#endif
+
+namespace
+{
+	// CTest SKIP_RETURN_CODE, used when the compiler can't build with ThreadSanitizer
+	constexpr int skip_return_code = 77;
+
+	void write_file(const fs::path &path, std::string_view contents)
+	{
+		fs::create_directories(path.parent_path());
+		std::ofstream(path, std::ios::binary) << contents;
+	}
+
+	int run_command(const std::string &command)
+	{
+		return std::system(command.c_str());
+	}
+
+	// the first device command in plan order is called by every thread once its loads are done
+	const vgen::command_data &get_hot_command(const vgen::emission_plan &plan)
+	{
+		for (const auto &block : plan.device_blocks)
+			for (const auto &section : block.sections)
+				for (auto command : section.commands)
+					if (command->name != "vkGetDeviceProcAddr"sv)
+						return *command;
+
+		throw std::runtime_error("The registry has no device commands");
+	}
+
+	// threads that all initialize the loader, load the same instance and device, and call the hot command
+	// the stand-in driver counts every lookup, so a second load by any thread shows up as a higher count than one thread gets
+	// the synthetic registry only passes scalars and pointers, so a 0 fits every argument and return value
+	void write_driver(fmt::memory_buffer &out, const vgen::command_data &command)
+	{
+		auto return_type = std::string_view(command.prototype).substr(0, command.prototype.rfind(command.name));
+		auto arguments = command.param_names.empty() ? 0 : std::count(begin(command.param_names), end(command.param_names), ',') + 1;
+
+		fmt::format_to(std::back_inserter(out), R"(#include <vulkan_loader.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_THREADS 64
+
+static atomic_size_t lookups;
+static atomic_size_t calls;
+static size_t calls_per_thread;
+
+static void VKAPI_PTR stub(void)
+{{
+}}
+
+static {0}VKAPI_PTR hot_stub({1})
+{{
+	atomic_fetch_add_explicit(&calls, 1, memory_order_relaxed);
+{2}}}
+
+static PFN_vkVoidFunction VKAPI_PTR get_device_proc(VkDevice device, const char *name);
+
+static PFN_vkVoidFunction VKAPI_PTR get_instance_proc(VkInstance instance, const char *name)
+{{
+	(void)instance;
+	atomic_fetch_add_explicit(&lookups, 1, memory_order_relaxed);
+
+	if (strcmp(name, "vkGetInstanceProcAddr") == 0)
+		return (PFN_vkVoidFunction)get_instance_proc;
+	if (strcmp(name, "vkGetDeviceProcAddr") == 0)
+		return (PFN_vkVoidFunction)get_device_proc;
+	if (strcmp(name, "{3}") == 0)
+		return (PFN_vkVoidFunction)hot_stub;
+
+	return stub;
+}}
+
+static PFN_vkVoidFunction VKAPI_PTR get_device_proc(VkDevice device, const char *name)
+{{
+	(void)device;
+	return get_instance_proc(0, name);
+}}
+
+static char instance, device;
+
+static void *run(void *arg)
+{{
+	size_t i;
+	(void)arg;
+
+	vgen_init_vulkan_loader(get_instance_proc);
+	vgen_load_instance_procs((VkInstance)&instance);
+	vgen_load_device_procs((VkDevice)&device);
+
+	for (i = 0; i < calls_per_thread; ++i)
+		{3}()",
+			return_type, command.params.empty() ? "void"sv : command.params, command.returns_void ? "" : "\treturn 0;\n", command.name);
+
+		for (std::ptrdiff_t i = 0; i < arguments; ++i)
+			fmt::format_to(std::back_inserter(out), "{0}0", i == 0 ? "" : ", ");
+
+		fmt::format_to(std::back_inserter(out), R"();
+
+	return 0;
+}}
+
+int main(int argc, char *argv[])
+{{
+	pthread_t threads[MAX_THREADS];
+	int i, thread_count = argc > 1 ? atoi(argv[1]) : 1;
+	calls_per_thread = argc > 2 ? (size_t)atol(argv[2]) : 1000;
+
+	if (thread_count < 1 || thread_count > MAX_THREADS)
+		return 2;
+
+	for (i = 0; i < thread_count; ++i)
+		if (pthread_create(&threads[i], 0, run, 0) != 0)
+			return 2;
+
+	for (i = 0; i < thread_count; ++i)
+		pthread_join(threads[i], 0);
+
+	if (atomic_load(&calls) != calls_per_thread * (size_t)thread_count)
+		return 1;
+
+	printf("%zu\n", atomic_load(&lookups));
+	return 0;
+}}
+)");
+	}
+
+	std::size_t run_driver(const fs::path &program, std::size_t threads, std::size_t calls)
+	{
+		auto lookups_file = program;
+		lookups_file.replace_extension(fmt::format(".{0}.txt", threads));
+		if (auto status = run_command(fmt::format(R"(TSAN_OPTIONS="halt_on_error=1 exitcode=66" "{0}" {1} {2} > "{3}")", program.string(), threads, calls, lookups_file.string())); status != 0)
+			throw std::runtime_error(fmt::format("{0} threads: the driver failed ({1}), see the ThreadSanitizer report above", threads, status));
+
+		auto file = std::fopen(lookups_file.string().c_str(), "r");
+		if (!file)
+			throw std::runtime_error("Unable to read " + lookups_file.string());
+
+		std::size_t lookups = 0;
+		auto read = std::fscanf(file, "%zu", &lookups);
+		std::fclose(file);
+
+		if (read != 1)
+			throw std::runtime_error("Unexpected output in " + lookups_file.string());
+
+		return lookups;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		cxxopts::Options options("vgen-stress", "Calls the thread safe loader from many threads at once under ThreadSanitizer");
+
+		// clang-format off
+		options.add_options()
+			("h,help", "Show this help")
+			("cc", "C compiler", cxxopts::value<std::string>()->default_value(VGEN_STRESS_CC))
+			("cflags", "flags passed to every compile", cxxopts::value<std::string>()->default_value("-O1 -g -fsanitize=thread"))
+			("work-dir", "directory for the generated and compiled files", cxxopts::value<std::string>()->default_value("vgen-stress"))
+			("threads", "threads racing to load the loader, at most 64", cxxopts::value<std::size_t>()->default_value("16"))
+			("calls", "calls of a command by each thread once loaded", cxxopts::value<std::size_t>()->default_value("1000"))
+			("n,runs", "runs of the racing threads, a race may not show up in every one", cxxopts::value<std::size_t>()->default_value("20"));
+		// clang-format on
+
+		auto parsed_options = options.parse(argc, argv);
+		if (parsed_options.count("help"))
+		{
+			fmt::print("{0}", options.help());
+			return 0;
+		}
+
+		auto work_dir = fs::absolute(parsed_options["work-dir"].as<std::string>());
+		auto compiler = fmt::format("{0} {1}", parsed_options["cc"].as<std::string>(), parsed_options["cflags"].as<std::string>());
+		auto threads = std::clamp<std::size_t>(parsed_options["threads"].as<std::size_t>(), 2, 64);
+		auto calls = parsed_options["calls"].as<std::size_t>();
+		auto runs = std::max<std::size_t>(parsed_options["runs"].as<std::size_t>(), 1);
+
+		// not every compiler and platform has ThreadSanitizer, which is no reason to fail
+		write_file(work_dir / "probe.c", "int main(void)\n{\n\treturn 0;\n}\n");
+		if (run_command(fmt::format(R"({0} "{1}" -o "{2}")", compiler, (work_dir / "probe.c").string(), (work_dir / "probe").string())) != 0 || run_command(fmt::format(R"("{0}")", (work_dir / "probe").string())) != 0)
+		{
+			fmt::print("{0} can't build and run with ThreadSanitizer, skipping\n", compiler);
+			return skip_return_code;
+		}
+
+		fmt::memory_buffer registry;
+		vgen::write_synthetic_registry(registry, vgen::registry_shape{});
+
+		pugi::xml_document doc;
+		if (auto result = doc.load_buffer(registry.data(), registry.size(), pugi::parse_default | pugi::parse_trim_pcdata); !result)
+			throw std::runtime_error(result.description());
+
+		auto version = vgen::read_vulkan_header_version(doc);
+		auto commands = vgen::read_commands(doc);
+		auto features = vgen::read_features(doc);
+		auto extensions = vgen::read_extensions(doc);
+		auto plan = vgen::build_emission_plan(version, features, extensions, commands);
+
+		fmt::memory_buffer header;
+		vgen::write_stand_in_vulkan_header(header, version, features, extensions, commands);
+		write_file(work_dir / "include" / "vulkan" / "vulkan.h", to_string(header));
+
+		for (const auto &file : vgen::generate_loader(plan, {.variant = vgen::loader_variant::prototypes, .thread_safe = true}))
+			write_file(work_dir / file.name, file.contents);
+
+		fmt::memory_buffer driver;
+		write_driver(driver, get_hot_command(plan));
+		write_file(work_dir / "driver.c", to_string(driver));
+
+		auto program = work_dir / "stress";
+		if (auto status = run_command(fmt::format(R"({0} -pthread -I"{1}" -I"{2}" "{3}" "{4}" -o "{5}")", compiler, (work_dir / "include").string(), work_dir.string(), (work_dir / "vulkan_loader.c").string(), (work_dir / "driver.c").string(), program.string())); status != 0)
+			throw std::runtime_error(fmt::format("Compiling the stress driver failed ({0})", status));
+
+		// one thread does each load once, racing threads must share those loads rather than add their own
+		auto expected = run_driver(program, 1, calls);
+		fmt::print("one thread: {0} lookups\n", expected);
+
+		for (std::size_t run = 0; run < runs; ++run)
+		{
+			if (auto lookups = run_driver(program, threads, calls); lookups != expected)
+				throw std::runtime_error(fmt::format("run {0}: {1} threads made {2} lookups, one thread makes {3}", run, threads, lookups, expected));
+		}
+
+		fmt::print("{0} threads, {1} runs: every run shared one load\n", threads, runs);
+	}
+	catch (std::exception &e)
+	{
+		fmt::print(stderr, "{0}\n", e.what());
+		return 1;
+	}
+}